@@ -0,0 +1,61 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __CANCEL_HH
+#define __CANCEL_HH
+
+// Cancellation scope of a search (parallel find, branch and bound): once
+// the answer is known the rest of the DAG below the scope is not needed.
+// A job opens a scope for the children of its next fork, and their
+// descendants inherit it through the Forks. Cancelling the scope, or a
+// scope it is nested in, lets a running job see it with Job::cancelled()
+// and return early, and makes workers skip the tasks of the scope they
+// dequeue after that: such a task joins without running, so its Fork still
+// counts down and the scheduler unwinds its bookkeeping as for any join.
+// Continuations always run, since they may have to free what their task
+// allocated. The scope has to outlive the children of the fork it was
+// opened for; the continuation of that fork may free it.
+
+#include <stddef.h>
+
+class CancelScope {
+  friend class Fork;
+  CancelScope *       _outer;                   // Scope of the job that opened us
+  volatile bool       _cancelled;
+
+public:
+  CancelScope () : _outer (NULL), _cancelled (false) {}
+
+  void cancel () {_cancelled = true;}
+  bool cancelled () {
+    for (CancelScope * s=this; s!=NULL; s=s->_outer)
+      if (s->_cancelled)
+	return true;
+    return false;
+  }
+};
+
+#endif
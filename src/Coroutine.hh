@@ -0,0 +1,150 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __COROUTINE_HH
+#define __COROUTINE_HH
+
+// Jobs written as C++20 coroutines instead of stage state machines. The
+// body of a CoJob is a coroutine that forks with co_await spawn(...): the
+// frame is suspended, the job forks with itself as the continuation, and
+// the frame is resumed when the job runs again after the children have
+// joined. The locals of the body live across spawns, and no continuation
+// job is allocated. The job joins when the body returns.
+//
+// The frame is allocated in the job's scratch arena (Job::scratch), so it
+// comes from the pool of the cluster the task is anchored at and is charged
+// to it like any other temporary of the task. size() and strand_size() are
+// those of the whole task, as for an HR2Job; strand_size() must not depend
+// on how far the body has got, see Job::fork.
+//
+// Needs a compiler with coroutines (-std=c++20); TP_COROUTINES tells
+// whether they are available.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define TP_COROUTINES 1
+
+#include <coroutine>
+#include "Job.hh"
+#include "ThreadPool.hh"
+
+class CoJob;
+
+class CoBody {
+public:
+  struct promise_type {
+    // The body is a member of the job, which is passed in first
+    template <class... Args>
+    void * operator new (size_t bytes, CoJob & job, Args &...) {return alloc_frame (bytes, job);}
+    void * operator new (size_t bytes) {
+      std::cerr<<"Error: a CoBody has to be a member function of a CoJob"<<std::endl;
+      exit(-1);
+    }
+    void operator delete (void * frame) {}     // Released with the arena when the job joins
+
+    CoBody get_return_object () {
+      return CoBody (std::coroutine_handle<promise_type>::from_promise (*this));
+    }
+    std::suspend_always initial_suspend () {return std::suspend_always ();}
+    std::suspend_always final_suspend () noexcept {return std::suspend_always ();}
+    void return_void () {}
+    void unhandled_exception () {
+      std::cerr<<"Error: exception in the body of a CoJob"<<std::endl;
+      exit(-1);
+    }
+  };
+
+  static void * alloc_frame (size_t bytes, CoJob & job);
+
+  std::coroutine_handle<promise_type> _frame;
+  explicit CoBody (std::coroutine_handle<promise_type> frame) : _frame (frame) {}
+};
+
+class CoJob : public HR2Job {
+  std::coroutine_handle<> _frame;               // NULL until the job first runs
+
+public:
+  CoJob (bool del=true) : HR2Job (del), _frame (nullptr) {}
+
+  virtual CoBody body () = 0;
+
+  void function () {
+    if (!_frame)
+      _frame = body ()._frame;
+    _frame.resume ();
+    if (get_thread()->reused (this))           // Suspended at a spawn, resumed as our continuation
+      return;
+    _frame.destroy ();
+    _frame = nullptr;
+    join ();
+  }
+
+  // co_await spawn (children) forks them and resumes the body once they
+  // have joined. The body must not touch the job while suspended, it can
+  // only be resumed by the continuation.
+  class Spawn {
+    CoJob *   _job;
+    int       _num_jobs;
+    Job **    _children;
+  public:
+    Spawn (CoJob * job, int num_jobs, Job ** children)
+      : _job (job), _num_jobs (num_jobs), _children (children) {}
+    bool await_ready () {
+      if (_num_jobs > 0)
+	return false;
+      delete [] _children;
+      return true;
+    }
+    void await_suspend (std::coroutine_handle<>) {
+      _job->fork (_num_jobs, _children, _job);  // May resume the body before it returns
+    }
+    void await_resume () {}
+  };
+
+  // children must come from new[], the fork takes it over
+  Spawn spawn (int num_jobs, Job ** children) {return Spawn (this, num_jobs, children);}
+  Spawn spawn (HR2Job * child) {
+    Job ** children = new Job*[1];
+    children[0] = child;
+    return Spawn (this, 1, children);
+  }
+  Spawn spawn (HR2Job * child0, HR2Job * child1) {
+    Job ** children = new Job*[2];
+    children[0] = child0;
+    children[1] = child1;
+    return Spawn (this, 2, children);
+  }
+};
+
+inline void *
+CoBody::alloc_frame (size_t bytes, CoJob & job) {
+  return job.scratch (bytes);
+}
+
+#else
+#define TP_COROUTINES 0
+#endif
+
+#endif
@@ -28,22 +28,35 @@
 
 Fork::Fork (Fork *parent_fork, Job * parent_job,
 	    int num_jobs, Job **children,
-	    Job *cont_job) {
+	    Job *cont_job, int num_ready,
+	    CancelScope *scope) {
   _num_jobs = num_jobs;
-  _num_synced_jobs = 0;
-  _count_mutex = new Mutex;
+  _num_ready = num_ready < 0 ? num_jobs : num_ready;
+  _num_pending = num_jobs+1;                   // The children, and spawn until it is done with us
   _parent_fork = parent_fork;
   _parent_job = parent_job;
   _parent_job_id = parent_job->get_id();
+  _scope = parent_fork==NULL ? NULL : parent_fork->_scope;
+  if (scope != NULL) {                         // Nested in the scope of the job that forked
+    scope->_outer = _scope;
+    _scope = scope;
+  }
+#if LEAK_CHECK
+  __sync_fetch_and_add (&num_live_forks, 1);
+#endif
   
-  _jobs = new Job*[_num_jobs];
+  _jobs = children;                            // Ours from now on
   for (int i=0; i<_num_jobs; ++i) {
-    _jobs[i] = children[i];
     _jobs[i]->_parent_fork = this;
+    _jobs[i]->_priority = parent_job->_priority;
   }
 
+  _completes = NULL;
   _cont_job = cont_job;
+  if (_cont_job == NULL)                       // A completion fork, see Job::fork
+    return;
   _cont_job->_parent_fork = _parent_fork;
+  _cont_job->_priority = parent_job->_priority;
   _cont_job->_strand_id = parent_job->_strand_id;
 }
 
@@ -55,30 +68,47 @@ Fork::spawn (PoolThr * thr) {
   for (int i=0; i<_num_jobs; ++i) 
     _jobs[i]->_strand_id = _jobs[i]->_id;
 
-  _thr->get_pool()->add_jobs (_num_jobs, _jobs, _thr); // Need to change this. This channels
+  _thr->get_pool()->add_jobs (_num_ready, _jobs, _thr); // Need to change this. This channels
                                                 // jobs through a single point.
                                                 // At this point this is also a livelock
-  
+  release (_thr);
 }
 
 Fork::~Fork () {
-//when is this called, and what can be deleted ??
+  delete [] _jobs;
+#if LEAK_CHECK
+  __sync_fetch_and_sub (&num_live_forks, 1);
+#endif
 }
 
 int
 Fork::join (Job * job) {
-  _count_mutex->lock ();
   _thr->get_pool()->done_job (job, job->get_thread(), true);
-  if (++_num_synced_jobs == _num_jobs) {
-    if (_cont_job == NULL) {
-      _thr->get_pool()->_idle_cond.broadcast();
-    } else { 
-      _thr->get_pool()->add_job (_cont_job, job->_thread);
-    }
-    _count_mutex->unlock();
-    return 0;
-  } else {
-    _count_mutex->unlock();
+  return release (job->get_thread());
+}
+
+// Called once by each child as it joins and once by spawn. The last call
+// enqueues the continuation and deletes the fork: by then every child has
+// joined and spawn no longer needs it.
+int
+Fork::release (PoolThr * thr) {
+  if (__sync_sub_and_fetch (&_num_pending, 1) > 0)
     return -1;
+  if (_completes != NULL) {                    // The job's last continuation joined,
+    ThreadPool * pool = thr->get_pool();        // the job itself joins now
+    Fork * parent = _parent_fork;
+    pool->completed (_completes);
+    delete this;
+    if (parent != NULL)
+      return parent->release (thr);
+    pool->reset_null_join ();
+    return 0;
+  }
+  if (_cont_job == NULL) {
+    _thr->get_pool()->_idle_cond.broadcast();
+  } else { 
+    _thr->get_pool()->add_job (_cont_job, thr);
   }
+  delete this;
+  return 0;
 }
@@ -59,6 +59,8 @@ Job*
 Scheduler::get (int thread_id) {
 	
 	Job* ret;
+	if (thread_id >= 0 && thread_id < _num_threads && !active (thread_id))
+		return NULL;             // The others take from the common queue
 	_queue_lock.lock();
 	if (_job_queue.size() == 0) {
 		ret = NULL;
@@ -80,6 +82,18 @@ void
 Scheduler::print_scheduler_stats () {
 }
 
+void
+Scheduler::set_active (int thread_id, bool on) {
+	check_range (thread_id, 0, _num_threads, new std::string (__func__));
+	_active[thread_id] = on;
+}
+
+void
+Scheduler::set_cluster_active (int level, int index, bool on) {
+	std::cerr<<__func__<<": this scheduler has no clusters"<<std::endl;
+	exit(-1);
+}
+
 void
 Local_Scheduler::add(Job *job, int thread_id) {
 	check_range (thread_id, 0, _num_threads+1, new std::string (__func__));
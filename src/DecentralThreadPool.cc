@@ -36,21 +36,27 @@
 
 #include "ThreadPool.hh"
 #include "threadTimers.hh"
+#include "Locks.hh"
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <assert.h>
 #include "test.h"
 #include "knobs.hh"
 
-#if LOG == 1
 static std::ostringstream log_stream;
 ThreadTimer *split_timer;
-#define ACTIVE 0
-#define NO_JOB 1
-#define GET 2
-#define ADD 3
-#define DONE 4
+#define ACTIVE PoolThr::SPLIT_ACTIVE
+#define NO_JOB PoolThr::SPLIT_NO_JOB
+#define GET PoolThr::SPLIT_GET
+#define ADD PoolThr::SPLIT_ADD
+#define DONE PoolThr::SPLIT_DONE
+
+// Time jobs of each priority class wait in the queues, in us (_log)
+ThreadTimer *queue_wait;
+ThreadTimer *max_queue_wait;
+ThreadCounter *num_queued;
 
 ThreadCounter *tries;
 #define NUM_TRIES 0;
@@ -58,7 +64,19 @@ ThreadCounter *tries;
 #define NUM_SAMPLES 2;
 
 long long int start_time,end_time;
-#endif
+
+static int
+env_option (const char * name, int def) {
+  char * value = getenv (name);
+  return value != NULL ? atoi (value) : def;
+}
+
+TPOptions::TPOptions ()
+  : _log (env_option ("TP_LOG", LOG) == 1),
+    _counters (env_option ("TP_COUNTERS", COUNTERS_ENABLED) == 1),
+    _strand_size_mode (env_option ("TP_STRAND_SIZE_MODE", STRAND_SIZE_MODE)) {}
+
+TPOptions tp_options;
 
 __inline__
 ull_t get_time ()  {
@@ -74,19 +92,6 @@ ull_t get_time ()  {
 }
  
 
-#define DECLARE_TIMER_VARS		\
-  volatile ull_t before=get_time();	\
-  volatile ull_t after=0;
-
-#define ADD_TIME_TO(x)					\
-  after = get_time();					\
-  split_timer->add(_thread_no, x, after-before);		\
-  before = after;
-
-#define RESET_TIMER				\
-  after = get_time();				\
-  before = after;
-
 //Global threadpool
 ThreadPool * thread_pool = NULL;
 
@@ -100,39 +105,20 @@ void sleep_for_nanoseconds (long int nanosecs) {
 
 void
 PoolThr::inf_loop () {
-    _pool->_pthread_map[_thread_no] = syscall (__NR_gettid);
+  loop (_pool->_scheduler);
+}
 
-    _del_mutex.lock();
-    #if LOG==1
-    DECLARE_TIMER_VARS;
-    #endif
-    
-    while ( !_pool->null_joined() ) {
-
-      #if LOG == 1
-      //tries->increment(_thread_no, SUM_NUM_TRIES);
-      //tries->increment(_thread_no, NUM_TRIES);
-      ADD_TIME_TO (NO_JOB);
-      #endif
-
-      //if (tries->get(_thread_no,NUM_TRIES) > 1)   // Not the first attempt
-      //for (volatile int i=1; i<(1<<11); ++i); 
-      
-      if ( (_job=_pool->_scheduler->get(_thread_no)) != NULL) {
-        #if LOG == 1
-	//tries->increment(_thread_no,NUM_SAMPLES);
-	//tries->reset(_thread_no,NUM_TRIES);
-	ADD_TIME_TO (GET);
-        #endif
-      
-	run_job();
-      
-        #if LOG == 1
-	ADD_TIME_TO (ACTIVE);
-        #endif
-      }
-  }
-    
+void
+PoolThr::enter_loop () {
+  _pool->_pthread_map[_thread_no] = syscall (__NR_gettid);
+
+  _del_mutex.lock();
+  if (TP_LOGGING)
+    _split_start = get_time();
+}
+
+void
+PoolThr::exit_loop () {
   _pool->_idle_cond.lock(); 
   _pool->_idle_count++;
   if (_pool->_idle_count == _pool->_max_parallel)
@@ -142,12 +128,29 @@ PoolThr::inf_loop () {
   _del_mutex.unlock();
 }
 
+void
+PoolThr::log_wait (Job * job) {
+  long long int wait = (uint)(get_time()/1000) - job->_queued_at; // Wraps after an hour
+  queue_wait->add (_thread_no, job->priority(), wait);
+  max_queue_wait->max (_thread_no, job->priority(), wait);
+  num_queued->increment (_thread_no, job->priority());
+}
+
+void
+PoolThr::log_split (int split) {
+  ull_t now = get_time();
+  split_timer->add(_thread_no, split, now-_split_start);
+  _split_start = now;
+}
+
 // ThreadPool - implementation
-ThreadPool::ThreadPool ( const uint max_p , Scheduler* scheduler, uint * proc_ids) {
+ThreadPool::ThreadPool ( const uint max_p , Scheduler* scheduler, uint * proc_ids, bool spawn) {
   _max_parallel = max_p;
   _threads = new PoolThr*[ _max_parallel ];
   _idle_count = 0;
   _null_join = false;
+  _num_roots = 0;
+  _num_hungry = 0;
 
   if (scheduler == NULL) // Use default scheduler
     _scheduler = new Scheduler(_max_parallel);
@@ -166,9 +169,20 @@ ThreadPool::ThreadPool ( const uint max_p , Scheduler* scheduler, uint * proc_id
   _pthread_map = new pid_t [_max_parallel+1]; // The last one is for the main thread
   _pthread_map[_max_parallel] = syscall (__NR_gettid);
   _scheduler->set_pthread_map (_pthread_map);
-  
+
+  if (spawn)
+    create_threads (proc_ids);
+}
+
+PoolThr*
+ThreadPool::new_thread ( uint thread_no ) {
+  return new PoolThr( thread_no, this );
+}
+
+void
+ThreadPool::create_threads ( uint * proc_ids ) {
   for ( uint i = 0; i < _max_parallel; i++ ) {
-    _threads[i] = new PoolThr( i, this );
+    _threads[i] = new_thread( i );
     
     
     if ( _threads == NULL )
@@ -200,16 +214,59 @@ PoolThr::run_job() {
   if (_job == NULL)
     std::cerr<<"Error: thread tried to run a NULL job"<<std::endl;
 
-  _job->set_thread (this);
+  current_thread = this;
   assert (_job->_executed == false);
-  _job->run();                                 // execute job
-  _job->_executed = true;
-  
+  if (TP_LOGGING)
+    log_wait (_job);
+  if (!_job->is_cont_job() && _job->cancelled())
+    _job->skip();                              // Its scope was cancelled while it was queued
+  else
+    _job->run();                               // execute job
+  if (_reused == _job) {                       // Enqueued again as its own continuation,
+    _reused = NULL;                            // it may be running on another thread already
+    _job = NULL;
+    return;
+  }
   _job->unlock();
   if (_job->deletable()) {
     delete _job;
-    _job = NULL;
+  } else {                                     // Someone may sync on it, and free it once we set this
+    _pool->completed (_job);
+  }
+  _job = NULL;
+}
+
+// Called by a job running on this thread that syncs with another job.
+// Jobs come from the scheduler's get for this thread, so under the HR
+// schedulers they are those queued at the clusters the thread is in.
+// After HELP_EMPTY_GETS empty gets it sleeps on the completion condition
+// for a while. Jobs it runs may sync in turn; past HELP_DEPTH nested
+// syncs it only sleeps, so that the stack stays bounded.
+void
+PoolThr::help (Job * job) {
+  Job * waiting = _job;
+  int empty_gets = 0;
+  _pool->_scheduler->sync_wait (waiting, _thread_no, true);
+  ++_help_depth;
+  while (!job->executed()) {
+    if ( _help_depth <= HELP_DEPTH
+	 && (_job=_pool->_scheduler->get(_thread_no)) != NULL) {
+      empty_gets = 0;
+      set_hungry (false);
+      run_job ();
+    } else if ( _help_depth <= HELP_DEPTH && ++empty_gets < HELP_EMPTY_GETS) {
+      set_hungry (true);
+      cpu_relax ();
+    } else {
+      empty_gets = 0;
+      set_hungry (false);
+      _pool->wait_completed (job, HELP_WAIT_USEC);
+    }
   }
+  --_help_depth;
+  set_hungry (false);
+  _job = waiting;
+  _pool->_scheduler->sync_wait (waiting, _thread_no, false);
 }
 
 ThreadPool*
@@ -233,24 +290,24 @@ ThreadPool::set_thread_affinity (uint thread_id, uint proc_id) {
 
 void                                                
 ThreadPool::add_jobs (int num_jobs, Job ** jobs, PoolThr* thr ) { 
-  if ( jobs == NULL )
+  if ( jobs == NULL || num_jobs == 0 )        // A fork with no children only suspends its job
     return;
   
   for (int i=0;i<num_jobs;++i) 
     jobs[i]->lock();  // lock job for synchronisation
     
-#if LOG==1
-  long int before_add = get_time();
-  #endif
+  long int before_add = TP_LOGGING ? get_time() : 0;
+  if (TP_LOGGING)
+    for (int i=0;i<num_jobs;++i)
+      jobs[i]->_queued_at = before_add/1000;
 
   if (thr != NULL)
-    _scheduler->add_multiple (num_jobs, jobs, thr->thread_no());
+    sched_add (num_jobs, jobs, thr->thread_no());
   else
-    _scheduler->add_multiple (num_jobs, jobs, _max_parallel);
+    sched_add (num_jobs, jobs, _max_parallel);
   
-  #if LOG==1
-  split_timer->add(thr!=NULL?thr->thread_no():0, ADD, get_time() - before_add);
-  #endif
+  if (TP_LOGGING)
+    split_timer->add(thr!=NULL?thr->thread_no():0, ADD, get_time() - before_add);
   
 }
 
@@ -272,15 +329,27 @@ ThreadPool::add_job ( Job * job,
 
 void
 ThreadPool::done_job ( Job * job , PoolThr* thr , bool deactivate) {
-  #if LOG==1
-  long int before_done = get_time();
-  #endif
+  long int before_done = TP_LOGGING ? get_time() : 0;
 
-  _scheduler->done (job, thr->thread_no(), deactivate);
+  sched_done (job, thr->thread_no(), deactivate);
 
-  #if LOG==1
-  split_timer->add(thr->thread_no(), DONE, get_time() - before_done);
-  #endif
+  if (TP_LOGGING)
+    split_timer->add(thr->thread_no(), DONE, get_time() - before_done);
+}
+
+void
+ThreadPool::park ( PoolThr * thr ) {
+  _park_cond.lock();
+  while (!_scheduler->active(thr->thread_no()) && !_null_join)
+    _park_cond.wait();
+  _park_cond.unlock();
+}
+
+void
+ThreadPool::unpark () {
+  _park_cond.lock();
+  _park_cond.broadcast();
+  _park_cond.unlock();
 }
 
 void
@@ -302,32 +371,40 @@ ThreadPool::sync ( Job * job ) {
     return;
   }
   
-  job->lock();
-  job->unlock();
+  if (current_thread != NULL && current_thread->get_pool() == this) {
+    current_thread->help (job);
+    return;
+  }
+  _sync_cond.lock();
+  while (!job->executed())
+    _sync_cond.wait();
+  _sync_cond.unlock();
 }
 
 // wait until all jobs have been executed
 void
 ThreadPool::sync_all () {
   _idle_cond.lock();
-  _idle_cond.wait();
+  while (_idle_count < _max_parallel)          // The threads may have left before we got here
+    _idle_cond.wait();
   std::cerr<<__func__<<std::endl;
   _idle_cond.unlock();
 }
 
 void
 start_timers (uint num_procs) {
-#if LOG == 1
   get_time();
   split_timer = new ThreadTimer(num_procs);
+  queue_wait = new ThreadTimer(num_procs);
+  max_queue_wait = new ThreadTimer(num_procs);
+  num_queued = new ThreadCounter(num_procs);
   tries = new ThreadCounter(num_procs);
-
-#endif
 }
 
 void
 print_timers (uint num_procs) {
-#if LOG == 1
+  if (!tp_options._log)
+    return;
     for (int i=0; i<num_procs; ++i) {
       split_timer->subtract(i, ACTIVE, split_timer->get(i,ADD)+split_timer->get(i,DONE));
       if (0) {
@@ -352,41 +429,63 @@ print_timers (uint num_procs) {
   std::cout<<"Total: "<<(end_time-start_time)/1000000<<" ms  "<<std::endl;
   std::cout<<"ms_Active: "<<split_timer->avg(ACTIVE)/1000000<<std::endl;
   std::cout<<"ms_Overhead: "<<(split_timer->avg(NO_JOB)+split_timer->avg(GET)+split_timer->avg(ADD)+split_timer->avg(DONE))/1000000<<std::endl;
+
+  for (int p=NUM_PRIORITIES-1; p>=0; --p) {
+    long long int wait=0, max_wait=0, num=0;
+    for (int i=0; i<num_procs; ++i) {
+      wait += queue_wait->get(i,p);
+      max_wait = std::max (max_wait, max_queue_wait->get(i,p));
+      num += num_queued->get(i,p);
+    }
+    if (num > 0)
+      std::cout<<"Queue wait, priority "<<p<<": avg "<<wait/num<<" us, max "<<max_wait
+	       <<" us over "<<num<<" jobs"<<std::endl;
+  }
   
   //print_global_counters();
   //print_local_counters(num_procs);
-    
-#endif
 }
 
 int *counters;
 // init global thread_pool
 void
-tp_init ( const uint p , uint * proc_ids, Scheduler * sched, Job * root) {
-
-  #if LOG == 1
+tp_init ( const uint p , uint * proc_ids, Scheduler * sched, Job * root,
+	  const TPOptions * options) {
+  if (options != NULL)
+    tp_options = *options;
   start_timers(p);
-  #endif
   
-  if ( thread_pool != NULL )
+  if ( thread_pool != NULL ) {
     delete thread_pool;
+    thread_pool = NULL;
+  }
  
-  if ((thread_pool = new ThreadPool( p , sched, proc_ids)) == NULL)
-    std::cerr << "(init_thread_pool) could not allocate thread pool" << std::endl;
+  tp_init_pool (new ThreadPool( p , sched, proc_ids), root);
+}
+
+void
+tp_init_pool ( ThreadPool * pool, Job * root ) {
+  if ( thread_pool != NULL && thread_pool != pool )
+    delete thread_pool;
 
+  if ((thread_pool = pool) == NULL)
+    std::cerr << "(init_thread_pool) could not allocate thread pool" << std::endl;
 
-  #if LOG == 1
 
-  if (COUNTERS_ENABLED) {
-    initPCM();
-    before_sstate = getSystemCounterState();
-  }
+  if (tp_options._log) {
+    if (tp_options._counters) {
+      initPCM();
+      before_sstate = getSystemCounterState();
+    }
 
-  before_ts = my_timestamp();
+    before_ts = my_timestamp();
 
-  start_time = get_time();
+    start_time = get_time();
     split_timer->activate();
-#endif
+    queue_wait->activate();
+    max_queue_wait->activate();
+    num_queued->activate();
+  }
   tp_run (root);
 }
 
@@ -395,7 +494,9 @@ void
 tp_run ( Job * job ) {
   if ( job == NULL )
     return;
+  job->_executed = false;                      // A job kept from an earlier run may run again
   thread_pool->set_null_join ();
+  thread_pool->add_root ();
   thread_pool->add_job( job );
 }
 
@@ -409,22 +510,38 @@ tp_sync ( Job * job ) {
 void
 tp_sync_all () {
   thread_pool->sync_all();
-#if LOG == 1
+  if (!tp_options._log)
+    return;
   split_timer->deactivate();
+  queue_wait->deactivate();
+  max_queue_wait->deactivate();
+  num_queued->deactivate();
   end_time = get_time();
-  // thread_pool->_scheduler->print_scheduler_stats();
+  if (LOCK_STATS)
+    thread_pool->_scheduler->print_scheduler_stats();
 
   print_timers(thread_pool->max_parallel());
-  if (COUNTERS_ENABLED)
+  if (tp_options._counters)
     after_sstate = getSystemCounterState();
   after_ts = my_timestamp();
   
-  if (COUNTERS_ENABLED) {
+  if (tp_options._counters) {
     std::cout<<"---------------------------------"<<std::endl;
     printDiff();
     std::cout<<"---------------------------------"<<std::endl;
   }
-#endif
+}
+
+void
+tp_set_active ( uint thread_id, bool on ) {
+  thread_pool->_scheduler->set_active (thread_id, on);
+  thread_pool->unpark ();
+}
+
+void
+tp_set_cluster_active ( int level, int index, bool on ) {
+  thread_pool->_scheduler->set_cluster_active (level, index, on);
+  thread_pool->unpark ();
 }
 
 // finish thread pool
@@ -432,12 +549,15 @@ void
 tp_done () {
   thread_pool->sync_all();
     
-#if LOG == 1
-  print_timers (thread_pool->max_parallel());
-  std::ofstream log_file;
-  log_file.open("Log");
-  log_file<<log_stream.str();
-  log_file.close();
+  if (tp_options._log) {
+    print_timers (thread_pool->max_parallel());
+    std::ofstream log_file;
+    log_file.open("Log");
+    log_file<<log_stream.str();
+    log_file.close();
+  }
+#if LEAK_CHECK
+  std::cout<<"Live jobs: "<<num_live_jobs<<", live forks: "<<num_live_forks<<std::endl;
 #endif
   //delete thread_pool;
 }
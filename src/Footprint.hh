@@ -0,0 +1,87 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __FOOTPRINT_HH
+#define __FOOTPRINT_HH
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_FOOTPRINT_RANGES  8                   // Ranges a job may list, see SizedJob::footprint
+#define MADVISE_MIN_BYTES     (1<<16)             // Rows at least this long also get madvise(WILLNEED)
+
+// Memory a task will touch: _count rows of _bytes each, the rows starting
+// _stride bytes apart. Contiguous arrays are a single row, submatrices
+// one row per matrix row.
+struct MemRange {
+  char *              _start;
+  size_t              _bytes;                     // Per row
+  int                 _count;                     // No. of rows
+  size_t              _stride;                    // In Bytes, between row starts
+  bool                _write;                     // Will the task write to it?
+
+  MemRange () {}
+  MemRange (const void *start, size_t bytes, bool write=false)
+    : _start ((char*)start), _bytes (bytes), _count (1), _stride (bytes), _write (write) {}
+  MemRange (const void *start, size_t bytes, int count, size_t stride, bool write=false)
+    : _start ((char*)start), _bytes (bytes), _count (count), _stride (stride), _write (write) {}
+
+  size_t total () const {return _bytes*_count;}
+};
+
+// Bring the footprint of a freshly pinned task towards the calling thread's
+// caches. Lines are prefetched until budget bytes (the size of the cache
+// the task was pinned to) have been issued; prefetching beyond that would
+// only evict what was prefetched first. Long rows are also passed to
+// madvise so that the kernel reads ahead pages not yet resident.
+// Returns the number of bytes prefetched.
+inline size_t warm_footprint (const MemRange *ranges, int num_ranges,
+			      int line_size, size_t budget) {
+  size_t issued = 0;
+  long page_size = sysconf (_SC_PAGESIZE);
+  for (int r=0; r<num_ranges; ++r) {
+    const MemRange & range = ranges[r];
+    for (int row=0; row<range._count; ++row) {
+      char * start = range._start + row*range._stride;
+      if (range._bytes >= MADVISE_MIN_BYTES) {
+	char * page = (char*)((uintptr_t)start & ~(uintptr_t)(page_size-1));
+	madvise (page, start+range._bytes-page, MADV_WILLNEED);
+      }
+      for (size_t off=0; off<range._bytes && issued<budget; off+=line_size, issued+=line_size) {
+	if (range._write)
+	  __builtin_prefetch (start+off, 1, 3);
+	else
+	  __builtin_prefetch (start+off, 0, 3);
+      }
+    }
+  }
+  return issued;
+}
+
+#endif
@@ -29,6 +29,7 @@
 
 #include "Job.hh"
 #include "ThreadPool.hh"
+#include "Cancel.hh"
 
 class Fork {
 //protected:
@@ -39,22 +40,27 @@ public:
 
   PoolThr       *  _thr;                       // Thread on which fork has been called
 
-  int              _num_synced_jobs;
   int              _num_jobs;
-  Mutex         *  _count_mutex;              // Mutex to count number of returned threads
+  int              _num_ready;                // Children spawn enqueues, siblings enqueue the others
+  volatile int     _num_pending;              // Children yet to join, plus one until spawn returns
   
-  Job           ** _jobs;                     // jobs to be spawned
+  Job           ** _jobs;                     // jobs to be spawned, the array passed to the constructor
   Job           *  _cont_job;                 // job to be run after all spawned jobs have returned
+  CancelScope   *  _scope;                    // Of the children, that of the parent fork unless one was opened
+  Job           *  _completes;                // Kept job whose last continuation joins here, see Job::fork
   
 public:
   Fork ( Fork *parent_fork, Job * parent_job,
 	 int num_jobs, Job **children,
-	 Job *cont_job); 
+	 Job *cont_job, int num_ready=-1,
+	 CancelScope *scope=NULL); 
   
   ~Fork ();
 
   void spawn (PoolThr * thr);                 // Spawn job in to the pool of this thread
   int  join  (Job * job);                     // Pass a pointer to the calling job
+  int  release (PoolThr * thr);               // Deletes the fork, see DecentralFork.cc
+  void hold    () {++_num_pending;}           // One more release before the continuation, see Job::hold
   Job* get_cont_job () {return _cont_job;}    // Return the continuation job 
 };
 
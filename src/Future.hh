@@ -0,0 +1,101 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+
+#ifndef __FUTURE_HH
+#define __FUTURE_HH
+
+// Jobs of a dependency DAG that is not series-parallel (a wavefront, the
+// blocks of an LU). Each FutureJob is the future of its own result: the
+// jobs declared to depend on it become ready once it joins, and a job
+// starts once all it depends on have joined, with no barrier in between.
+// Readiness is an atomic countdown of the inputs yet to join; the last
+// input to join enqueues the job through the scheduler's add, where the
+// job is pinned as any other child of the job that forked the DAG.
+
+#include "Job.hh"
+#include "ThreadPool.hh"
+
+class FutureJob : public HR2Job {
+  volatile int        _num_inputs;              // Jobs we depend on yet to join
+  int                 _num_outputs;
+  int                 _max_outputs;
+  FutureJob **        _outputs;                 // Jobs that depend on us
+
+public:
+  FutureJob (bool del=true)
+    : HR2Job (del),
+      _num_inputs (0), _num_outputs (0), _max_outputs (0), _outputs (NULL)
+    {}
+  ~FutureJob () {delete [] _outputs;}
+
+  // Start only once job has joined. Declare all edges before fork_dag.
+  void depends_on (FutureJob * job) {
+    if (job->_num_outputs == job->_max_outputs) {
+      job->_max_outputs = job->_max_outputs==0 ? 4 : 2*job->_max_outputs;
+      FutureJob ** outputs = new FutureJob*[job->_max_outputs];
+      for (int i=0; i<job->_num_outputs; ++i)
+	outputs[i] = job->_outputs[i];
+      delete [] job->_outputs;
+      job->_outputs = outputs;
+    }
+    job->_outputs[job->_num_outputs++] = this;
+    ++_num_inputs;
+  }
+
+  // Resolves the jobs that depend on this one. Hides Job::join, so the
+  // last strand of the job has to be a FutureJob: fork with this job as
+  // the continuation, not with a new one.
+  void join () {
+    for (int i=0; i<_num_outputs; ++i)
+      if (__sync_sub_and_fetch (&_outputs[i]->_num_inputs, 1) == 0)
+	current_thread->get_pool()->add_job (_outputs[i], current_thread);
+    HR2Job::join ();
+  }
+  void skip () {join ();}
+
+  // Fork the jobs of a DAG from parent, with cont_job to run once all of
+  // them have joined. Jobs that depend on none are enqueued now.
+  static void fork_dag (Job * parent, int num_jobs, FutureJob ** jobs, Job * cont_job) {
+    Job ** children = new Job*[num_jobs];
+    int num_ready = 0;
+    for (int i=0; i<num_jobs; ++i)
+      if (jobs[i]->_num_inputs == 0)
+	children[num_ready++] = jobs[i];
+    if (num_ready == 0 && num_jobs > 0) {
+      std::cerr<<"Error: a DAG of FutureJobs has no job to start with"<<std::endl;
+      exit(-1);
+    }
+    int num_waiting = num_ready;
+    for (int i=0; i<num_jobs; ++i)
+      if (jobs[i]->_num_inputs != 0)
+	children[num_waiting++] = jobs[i];
+    parent->fork (num_jobs, children, cont_job, num_ready);
+  }
+};
+
+#endif
@@ -262,7 +262,10 @@ HR_Scheduler::insert_task_in_queue (std::deque<SizedJob*> &task_queue, SizedJob
 			task_queue.insert (iter, sized_job);
 			return;
 		}*/
-	task_queue.push_back (sized_job);
+	std::deque<SizedJob*>::iterator iter = task_queue.end();   // Behind the jobs of its class or higher
+	while (iter != task_queue.begin() && (*(iter-1))->priority() < sized_job->priority())
+		--iter;
+	task_queue.insert (iter, sized_job);
 }
 
 void
@@ -0,0 +1,956 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __HRTSCHEDULER_HH
+#define __HRTSCHEDULER_HH
+
+#include "Scheduler.hh"
+#include "Locks.hh"
+#include "SigmaMuController.hh"
+#include "NumaPlacement.hh"
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+
+//#define NDEBUG  // Turn off asserts
+
+#define SIGMA (0.5)                               // Defaults for every level, see set_sigma/set_mu
+#define MU    (0.2)
+#define WARM_OCCUPANCY (0.25)                     // Warm a new pin if the rest of its cluster is below this
+
+// Space-bounded scheduler with the reservation scheme and the bucket/queue
+// layout chosen at compile time. The schedulers of the paper are instances:
+//
+//   HR2Scheduler    : HRTScheduler<LockedReservation, Buckets<HR2Job*> >
+//   HR2TopScheduler : HRTScheduler<LockedReservation, TopDistrBuckets<HR2Job*> >
+//   HR3Scheduler    : HRTScheduler<AtomicReservation, TopDistrBuckets<HR2Job*> >
+//   HR4Scheduler    : HRTScheduler<LockedReservation, DistrBuckets<HR2Job*> >
+//
+// The bucket type decides both how jobs are classified by size and which
+// levels use a distributed (per child) queue. ClusterLock is the lock taken
+// on clusters with more than one child (Mutex or one of Locks.hh). add/get/
+// done are final, so a caller holding the concrete type (see
+// StaticThreadPool) calls them directly.
+
+struct LockedReservation;
+struct AtomicReservation;
+
+// One cache in an explicitly described tree. Nodes are listed in level
+// order (root first), the children of a node following those of the nodes
+// before it, so the list is also the cluster layout. Leaves (threads) have
+// no children and must all be at the same depth; pad shallower branches
+// with single-child nodes, as the regular configurations do for L1.
+struct CacheNode {
+  int                 _num_children;              // 0 for a leaf
+  lluint              _size;                      // In Bytes, ignored for the root and leaves
+  int                 _block_size;                // In Bytes
+};
+
+template <class Reservation, class BucketSet, class ClusterLock = Mutex>
+class HRTScheduler : public Scheduler {
+  friend struct LockedReservation;
+  friend struct AtomicReservation;
+
+public:
+  // Clusters live in one level-ordered array (root first, leaves last), so
+  // the children of a cluster are contiguous. The geometry is written once
+  // while the tree is built; the fields updated by the threads start on a
+  // cache line of their own, and no two clusters share a line.
+  typedef struct Cluster {
+    const lluint      _size;                      // In Bytes
+    const uint        _block_size;                // In Bytes
+    const int         _num_children;              // No. of subclusters
+    const int         _sibling_id;
+    const int         _level;                     // 0 for the root
+    int               _size_slot;                 // Slot of _block_size in job size profiles, -1 if none
+    Cluster * const   _parent;
+    Cluster *         _children;                  // First child in the array
+    BucketSet *       _buckets;
+    volatile int      _active_leaves;             // Leaves below with an active thread
+
+    volatile lluint   _occupied __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    int               _locked_thread_id;          // Thread that locked this cluster
+    ClusterLock       _lock;
+
+    ScratchPool       _scratch __attribute__ ((aligned (CACHE_LINE_SIZE))); // Chunks for the arenas of tasks pinned here
+
+    Cluster (const lluint size, const int block_size, int num_children,
+	     int sibling_id, int level, Cluster * parent=NULL)
+      : _size (size),
+	_block_size (block_size),
+	_num_children (num_children),
+	_sibling_id (sibling_id),
+	_level (level),
+	_size_slot (-1),
+	_parent (parent),
+	_children (NULL),
+	_buckets (NULL),
+	_active_leaves (0),
+	_occupied (0),
+	_locked_thread_id (-1) {}
+    ~Cluster () {
+      delete _buckets;
+    }
+
+    void              lock      () {_lock.lock();}
+    void              unlock    () {_lock.unlock();}
+    bool              is_locked () {return _lock.is_locked();}
+  } __attribute__ ((aligned (CACHE_LINE_SIZE))) Cluster;
+
+protected:
+  // Per thread lock list, padded so that threads do not share lines
+  struct LockList {
+    int               _num_held;
+    Cluster **        _held;                      // In the order in which they were obtained
+  } __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+  class TreeOfCaches {
+  public:
+    int               _num_levels;
+    int               _num_leaves;
+    int               _num_clusters;
+
+    Cluster *         _clusters;                  // Level-ordered, _clusters[0] is the root
+    int     *         _level_offsets;             // Index of the first cluster of each level
+    volatile double * _sigmas;                    // Per level, 0 is the root
+    volatile double * _mus;
+
+    Cluster **        _ancestors;                 // Row per leaf: leaf, parent, ..., root
+    int               _ancestor_stride;           // Row length, padded to a cache line
+
+    LockList *        _locks;
+  };
+
+  TreeOfCaches *      _tree;
+
+  // With a memory budget, tasks that would be pinned at the root wait here
+  // until the root (RAM) has room for their size()
+  lluint              _root_budget;               // 0 if the root is unbounded
+  synchronized_queue<HR2Job*> _admission_queue;
+  volatile lluint     _num_deferred;              // Tasks that had to wait for admission
+
+  SigmaMuController * _controller;                // NULL unless adapting SIGMA/MU online
+
+  bool                _warm;                      // Prefetch footprints of newly pinned tasks?
+  volatile lluint     _num_warmed;
+
+  NumaPlacer *        _placer;                    // NULL unless moving pages to the pinning socket
+  int                 _numa_level;                // Level whose clusters are the NUMA nodes
+
+  int                 _profile_block_sizes[SIZE_PROFILE_SLOTS]; // Block size of each job size profile slot
+  int                 _num_profile_slots;
+
+public:
+  HRTScheduler (int num_threads,                  // Threads are logically numbered left to right.
+		int num_levels, int * fan_outs,   // num levels including top level RAM, f_{},
+		lluint * sizes, int * block_sizes,// M_{}, B_{}; M_0 is neglected
+		lluint root_budget=0)             // Bytes of RAM the running root tasks may use, 0 for no limit
+    : Scheduler (num_threads),
+      _root_budget (root_budget),
+      _num_deferred (0),
+      _controller (NULL),
+      _warm (false),
+      _num_warmed (0),
+      _placer (NULL),
+      _numa_level (1),
+      _num_profile_slots (0) {
+    int num_nodes;
+    CacheNode * nodes = regular_tree (num_levels, fan_outs, sizes, block_sizes, num_nodes);
+    init (num_nodes, nodes);
+    delete [] nodes;
+  }
+
+  HRTScheduler (int num_threads,                  // Threads are numbered in the order of the leaves
+		int num_nodes, const CacheNode * nodes,
+		lluint root_budget=0)
+    : Scheduler (num_threads),
+      _root_budget (root_budget),
+      _num_deferred (0),
+      _controller (NULL),
+      _warm (false),
+      _num_warmed (0),
+      _placer (NULL),
+      _numa_level (1),
+      _num_profile_slots (0) {
+    init (num_nodes, nodes);
+  }
+
+  ~HRTScheduler () {
+    for (int i=0; i<_tree->_num_leaves; ++i)
+      delete [] _tree->_locks[i]._held;
+    free (_tree->_locks);
+    delete_tree ();
+    delete [] _tree->_sigmas;
+    delete [] _tree->_mus;
+    delete _controller;
+    delete _placer;
+    delete _tree;
+  }
+
+  // ancestors(t)[h] is the cluster at height h above the leaf of thread t
+  Cluster ** ancestors (int thread_id) {
+    return _tree->_ancestors + thread_id*_tree->_ancestor_stride;
+  }
+
+  Cluster * root () {return _tree->_clusters;}
+
+  void add (Job *job, int thread_id) final {
+    add_multiple (1, &job, thread_id);
+  }
+
+  void add_multiple (int num_jobs, Job **uncast_jobs, int thread_id) final {
+    HR2Job * job = (HR2Job*)uncast_jobs[0];
+    for (int i=0; i<num_jobs; ++i)
+      if (starts_task ((HR2Job*)uncast_jobs[i]))
+	profile ((HR2Job*)uncast_jobs[i]);
+
+    /* Job added by an agent other than the threads */
+    if (thread_id == _num_threads) {
+      for (int i=0; i<num_jobs; ++i)
+	admit ((HR2Job*)uncast_jobs[i], 0);
+      return;
+    }
+
+    /* If root has no active job, set it here */
+    if (job->get_pin_cluster() == NULL) {
+      int child_id = ancestors(thread_id)[_tree->_num_levels-1]->_sibling_id;
+      for (int i=0; i<num_jobs; ++i)
+	admit ((HR2Job*)uncast_jobs[i], child_id);
+      return;
+    }
+
+    /* Add job to the approporiate queue */
+    Cluster ** anc = ancestors (thread_id);
+    int child_id=0;
+    for (int height=0; height<=_tree->_num_levels; ++height) {
+      Cluster * cur = anc[height];
+      if (job->get_pin_cluster() == cur) {
+	for (int i=0; i<num_jobs; ++i)
+	  cur->_buckets->add_job_to_bucket ((HR2Job*)uncast_jobs[i], child_id);
+	return;
+      }
+      child_id = cur->_sibling_id;
+    }
+
+    /* A continuation resumed by a thread outside its task's cluster, see Job::resume */
+    Cluster * pin = (Cluster*) job->get_pin_cluster();
+    for (int i=0; i<num_jobs; ++i) {
+      assert (((HR2Job*)uncast_jobs[i])->is_cont_job());
+      pin->_buckets->add_job_to_bucket ((HR2Job*)uncast_jobs[i], 0);
+    }
+  }
+
+  void done (Job *job, int thread_id, bool deactivate) final {
+    Reservation::release (this, (HR2Job*)job, thread_id, deactivate);
+  }
+
+  Job* get (int thread_id=-1) final {
+    if (_controller == NULL)
+      return find_job (thread_id);
+
+    HR2Job * job = find_job (thread_id);
+    _controller->count_get (thread_id, job==NULL);
+    if (_controller->due (thread_id))
+      _controller->adapt (_tree->_sigmas, _tree->_mus);
+    return job;
+  }
+
+  HR2Job* find_job (int thread_id) {
+    HR2Job * job = NULL;
+    Cluster ** anc = ancestors (thread_id);
+    bool draining = anc[0]->_active_leaves == 0;
+
+    for (int height=1; height<=_tree->_num_levels; ++height) {
+      Cluster * cur = anc[height];
+      int child_id = anc[height-1]->_sibling_id;
+      /* A deactivated thread only runs what no active thread can reach */
+      if (draining && cur->_active_leaves > 0)
+	return NULL;
+      if (height == _tree->_num_levels && _root_budget > 0)
+	admit_pending (child_id);
+      int level = cur->_buckets->get_job_from_bucket(&job, 0, child_id);
+      while (level != -1) {
+	int reject_level = cur->_level;
+	bool fitted = Reservation::fit (this, job, thread_id, height, level, &reject_level);
+	if (_controller != NULL)
+	  _controller->count_fit (thread_id, reject_level, !fitted);
+	if (fitted) {
+	  if (level > 0 && (_warm || _placer != NULL))
+	    anchored (job);
+	  return job;
+	}
+	else
+	  cur->_buckets->return_to_queue (job, level, child_id);
+	level = cur->_buckets->get_job_from_bucket(&job, 1+level, child_id);
+      }
+
+      if ( cur->_occupied > (lluint)((1-mu (cur))* cur->_size) )
+	return NULL;
+    }
+    return NULL;
+  }
+
+  bool more (int thread_id=-1) {
+    std::cerr<<__func__<<" has been deprecated"<<std::endl;
+    exit (-1);
+  }
+
+  // SIGMA: fraction of a level's cache a task pinned there may take.
+  // MU: share of a cluster a strand running below it is charged, and the
+  // cluster stops taking strands above (1-MU) occupancy. Both can be set
+  // while jobs run; queued jobs are re-bucketed when they are next popped.
+  void   set_sigma (int level, double sigma) {_tree->_sigmas[level] = sigma;}
+  void   set_mu    (int level, double mu)    {_tree->_mus[level] = mu;}
+  double sigma     (int level)               {return _tree->_sigmas[level];}
+  double mu        (Cluster * cluster)       {return _tree->_mus[cluster->_level];}
+
+  // Adjust SIGMA and MU online, see SigmaMuController.hh
+  void enable_adaptation () {
+    if (_controller == NULL)
+      _controller = new SigmaMuController (_num_threads, _tree->_num_levels+1);
+  }
+
+  // Cache misses observed at a level, input to the adaptive controller
+  void record_cache_misses (int level, lluint misses) {
+    if (_controller != NULL)
+      _controller->record_cache_misses (level, misses);
+  }
+
+  // A deactivated thread keeps running jobs queued at clusters with no
+  // active leaf left (tasks already pinned there, and their subtasks),
+  // then parks. Active threads never pin new tasks into such clusters
+  // since they are not on their path, so occupancy drains normally.
+  void set_active (int thread_id, bool on) {
+    Cluster ** anc = ancestors (thread_id);
+    if (!__sync_bool_compare_and_swap (&anc[0]->_active_leaves, on ? 0 : 1, on ? 1 : 0))
+      return;                                     // Already in that state
+    for (int h=1; h<=_tree->_num_levels; ++h)
+      __sync_fetch_and_add (&anc[h]->_active_leaves, on ? 1 : -1);
+    Scheduler::set_active (thread_id, on);
+  }
+
+  void set_cluster_active (int level, int index, bool on) {
+    if (level < 0 || level > _tree->_num_levels
+	|| index < 0 || index >= _tree->_level_offsets[level+1]-_tree->_level_offsets[level]) {
+      std::cerr<<__func__<<": no cluster "<<index<<" at level "<<level<<std::endl;
+      exit(-1);
+    }
+    Cluster * cluster = _tree->_clusters + _tree->_level_offsets[level] + index;
+    for (int t=0; t<_num_threads; ++t)
+      if (ancestors(t)[_tree->_num_levels-level] == cluster)
+	set_active (t, on);
+  }
+
+  // Prefetch the footprint of tasks pinned to a cache that is idle or
+  // lightly occupied, from the thread that pinned it, i.e. one of the
+  // threads of that cluster. Busy clusters are left alone, their cache is
+  // holding data for the tasks already running there.
+  void enable_warming () {_warm = true;}
+
+  // Move the pages of large tasks pinned at a level (1: sockets, the
+  // children of RAM) to the NUMA node of their cluster. The i-th cluster
+  // of that level is taken to be node i, as in the machine configurations
+  // where consecutive threads fill a socket. Does nothing on one node.
+  void enable_numa_placement (lluint min_bytes=NUMA_MIN_BYTES, int level=1) {
+    if (level < 1 || level >= _tree->_num_levels) {
+      std::cerr<<__func__<<": level "<<level<<" is not a cache level"<<std::endl;
+      exit(-1);
+    }
+    if (_placer == NULL)
+      _placer = new NumaPlacer (min_bytes);
+    _numa_level = level;
+  }
+
+  // Size the job once for every block size in the tree, so that fitting and
+  // releasing it read the profile instead of calling size() at each level.
+  // Done when a task is added, never for its continuations: a release must
+  // subtract what the task was pinned with.
+  void profile (HR2Job *job) {
+    for (int i=0; i<_num_profile_slots; ++i)
+      job->set_profile (i, job->size (_profile_block_sizes[i]),
+			job->strand_size (_profile_block_sizes[i]));
+  }
+
+  // Roots are not strands of a fork, but have no pin until admitted
+  bool starts_task (HR2Job *job) {
+    return !job->is_cont_job() || job->get_pin_cluster() == NULL;
+  }
+
+  lluint job_size (HR2Job *job, Cluster *cluster) {
+    return cluster->_size_slot >= 0 ? job->profiled_size (cluster->_size_slot)
+      : job->size (cluster->_block_size);
+  }
+
+  lluint job_strand_size (HR2Job *job, Cluster *cluster) {
+    return cluster->_size_slot >= 0 ? job->profiled_strand_size (cluster->_size_slot)
+      : job->strand_size (cluster->_block_size);
+  }
+
+  // A maximal task was just pinned below the root
+  void anchored (HR2Job *job) {
+    Cluster * pin = (Cluster*) job->get_pin_cluster();
+    if (pin->_level == 0)                         // RAM, nothing to warm or place
+      return;
+    lluint task_size = job_size (job, pin);
+    bool place = _placer != NULL && pin->_level == _numa_level && _placer->worth (task_size);
+    bool warm = _warm && pin->_occupied-task_size <= (lluint)(WARM_OCCUPANCY*pin->_size);
+    if (!place && !warm)
+      return;
+
+    MemRange ranges[MAX_FOOTPRINT_RANGES];
+    int num_ranges = job->footprint (ranges, MAX_FOOTPRINT_RANGES);
+    if (num_ranges == 0)
+      return;
+    if (place)                                    // First, so that warming reads local pages
+      _placer->place (ranges, num_ranges, pin-(_tree->_clusters+_tree->_level_offsets[_numa_level]));
+    if (warm) {
+      warm_footprint (ranges, num_ranges, CACHE_LINE_SIZE, pin->_size);
+      __sync_fetch_and_add (&_num_warmed, 1);
+    }
+  }
+
+  // Scratch arenas draw from, and are charged to, the cluster their task
+  // is anchored at (the root if it has not been pinned yet). The task's
+  // size is already reserved there, only scratch beyond it is charged.
+  void open_scratch (ScratchArena *arena, Job *job) {
+    Cluster * cluster = (Cluster*) ((HR2Job*)job)->get_pin_cluster();
+    if (cluster == NULL)
+      cluster = root();
+    else
+      arena->_reserved = job_size ((HR2Job*)job, cluster);
+    arena->_pool = &cluster->_scratch;
+    arena->_cluster = cluster;
+  }
+
+  void charge_scratch (ScratchArena *arena, lluint bytes, int thread_id) {
+    Reservation::charge (this, (Cluster*)arena->_cluster, bytes, thread_id);
+  }
+
+  // Pin a task at the root if the budget allows it, queue it otherwise
+  void admit (HR2Job *job, int child_id) {
+    if (Reservation::reserve_root (this, job)) {
+      root()->_buckets->add_job_to_bucket (job, child_id);
+    } else {
+      __sync_fetch_and_add (&_num_deferred, 1);
+      _admission_queue.push (job);
+    }
+  }
+
+  // Move waiting tasks to the root, in arrival order, while they fit
+  void admit_pending (int child_id) {
+    HR2Job * job;
+    while (_admission_queue.safepop_front (&job)) {
+      if (!Reservation::reserve_root (this, job)) {
+	_admission_queue.push_front (job);
+	return;
+      }
+      root()->_buckets->add_job_to_bucket (job, child_id);
+    }
+  }
+
+  lluint num_deferred () {return _num_deferred;}
+
+  // A root that syncs on another root, which may be waiting for admission,
+  // hands its reservation back until the sync returns; otherwise neither
+  // could ever run. The budget can be exceeded by its size once it goes on.
+  void sync_wait (Job *uncast_job, int thread_id, bool waiting) final {
+    HR2Job * job = (HR2Job*)uncast_job;
+    if (_root_budget == 0 || job->get_pin_cluster() != root() || !job->is_maximal())
+      return;
+    lluint task_size = job_size (job, root());
+    Reservation::charge (this, root(), waiting ? -task_size : task_size, thread_id);
+  }
+
+  // Contention on the cluster locks, summed over each level
+  void print_scheduler_stats() {
+    if (_controller != NULL)
+      _controller->print (_tree->_sigmas, _tree->_mus);
+    if (_root_budget > 0)
+      std::cout<<"Root budget: "<<_root_budget<<" bytes, deferred tasks: "
+	       <<_num_deferred<<std::endl;
+    if (_warm)
+      std::cout<<"Warmed pins: "<<_num_warmed<<std::endl;
+    if (_placer != NULL)
+      _placer->print ();
+    for (int l=0; l<_tree->_num_levels; ++l) {
+      LockStats level_stats;
+      for (int i=_tree->_level_offsets[l]; i<_tree->_level_offsets[l+1]; ++i)
+	level_stats.add (lock_stats (_tree->_clusters[i]._lock));
+      if (level_stats._acquires > 0) {
+	std::cout<<"Level "<<l<<" ";
+	level_stats.print ("cluster locks");
+      }
+    }
+  }
+
+  /* Should be called only by a thread holding a reservation on the cluster */
+  void pin (HR2Job *job, Cluster *cluster) {
+    assert (cluster->_occupied <= cluster->_size);
+    job->pin_to_cluster (cluster, job_size (job, cluster));
+  }
+
+  // Share of a cluster charged to a strand running below it, capped at MU.
+  // Recorded on the job, release and rollback take back what it was charged.
+  lluint strand_share (HR2Job *job, Cluster *cluster, int height) {
+    lluint strand_size = job_strand_size (job, cluster);
+    lluint cap = (lluint)(mu (cluster)*cluster->_size);
+    lluint share = strand_size < cap ? strand_size : cap;
+    job->set_share (height, share);
+    return share;
+  }
+
+  // Lock up 'node', and add that lock to the locked up node list
+  void lock (Cluster* node, int thread_id) {
+    if (node->_num_children > 1) {
+      node->lock();
+      assert (node->_locked_thread_id == -1);
+      node->_locked_thread_id = thread_id;
+      LockList & locks = _tree->_locks[thread_id];
+      locks._held[locks._num_held++] = node;
+    }
+  }
+
+  bool has_lock (Cluster* node, int thread_id) {
+    return (node->_num_children==1 || node->_locked_thread_id == thread_id);
+  }
+
+  // Check if the node is the last in the list of locked nodes,
+  void unlock (Cluster* node, int thread_id) {
+    if (node->_num_children > 1) {
+      LockList & locks = _tree->_locks[thread_id];
+      locks._held[--locks._num_held] = NULL;
+      assert (node->_locked_thread_id == thread_id);
+      node->_locked_thread_id = -1;
+      node->unlock();
+    }
+  }
+
+  // Release all locks held by thread in the inverse order they were obtained
+  void release_locks (int thread_id) {
+    LockList & locks = _tree->_locks[thread_id];
+    while (locks._num_held > 0)
+      unlock (locks._held[locks._num_held-1], thread_id);
+  }
+
+  void print_tree (Cluster * root, int num_levels, int total_levels=-1) {
+    if (total_levels == -1) total_levels=num_levels;
+    if (num_levels > 0) {
+      for (int i=0; i<total_levels-num_levels; ++i)
+	std::cout<<"\t\t";
+      std::cout<<"Occ:"<<root->_occupied<<" | "
+	       <<(root->is_locked() ? "L" : "U")<<std::endl;
+      for (int i=0; i<root->_num_children; ++i)
+	print_tree (root->_children+i, num_levels-1, total_levels);
+    }
+  }
+
+  void print_job (HR2Job *job) {
+    std::cout<<" Job: "<<job->get_id()
+	     <<", Str: "<<job->strand_id()
+	     <<", Pin: "<<job->get_pin_cluster()
+	     <<", Task_Size: "<<job->size(1)
+	     <<", Strand_Size: "<<job->strand_size(1)
+	     <<", cont_job? "<<job->is_cont_job()
+	     <<", maximal_job: "<<job->is_maximal()
+	     <<std::endl;
+  }
+
+protected:
+  // Node list for the usual one fan-out and one size per level
+  static CacheNode * regular_tree (int num_levels, int * fan_outs, lluint * sizes,
+				   int * block_sizes, int & num_nodes) {
+    num_nodes = 0;
+    for (int l=0, width=1; l<=num_levels; width*=(l<num_levels ? fan_outs[l] : 1), ++l)
+      num_nodes += width;
+    CacheNode * nodes = new CacheNode[num_nodes];
+    for (int l=0, width=1, n=0; l<=num_levels; width*=(l<num_levels ? fan_outs[l] : 1), ++l) {
+      for (int i=0; i<width; ++i, ++n) {
+	nodes[n]._num_children = l<num_levels ? fan_outs[l] : 0;
+	nodes[n]._size = l<num_levels ? sizes[l] : 0;
+	nodes[n]._block_size = l<num_levels ? block_sizes[l] : 1;
+      }
+    }
+    return nodes;
+  }
+
+  void init (int num_nodes, const CacheNode * nodes) {
+    _tree = new TreeOfCaches;
+    create_tree (num_nodes, nodes);
+    int num_levels = _tree->_num_levels;
+
+    _tree->_locks = (LockList*) aligned_alloc (CACHE_LINE_SIZE,
+						  _tree->_num_leaves * sizeof(LockList));
+    for (int i=0; i<_tree->_num_leaves; ++i) {
+      _tree->_locks[i]._num_held = 0;
+      _tree->_locks[i]._held = new Cluster*[num_levels+1+8]; // +8 is to pad each list
+      for (int j=0; j<num_levels+1; ++j)
+	_tree->_locks[i]._held[j] = NULL;
+    }
+  }
+
+  // Lay the clusters out in the order of the node list and build the
+  // ancestor table. Bucket thresholds are per cluster: for each depth
+  // below it, the largest cache of its own subtree at that depth, so a
+  // task is bucketed as low as some cluster could hold it. Clusters that
+  // are too small reject it in fit.
+  void create_tree (int num_nodes, const CacheNode * nodes) {
+    int * depth = new int[num_nodes];
+    int * first_child = new int[num_nodes];
+    int * parent = new int[num_nodes];
+    int next = 1, num_levels = -1, num_leaves = 0;
+    depth[0] = 0; parent[0] = -1;
+    for (int i=0; i<num_nodes; ++i) {
+      if (i>=next) {
+	std::cerr<<"Tree of caches: node "<<i<<" is not a child of any earlier node"<<std::endl;
+	exit(-1);
+      }
+      first_child[i] = next;
+      for (int c=0; c<nodes[i]._num_children; ++c, ++next) {
+	if (next < num_nodes) {
+	  depth[next] = depth[i]+1;
+	  parent[next] = i;
+	}
+      }
+      if (nodes[i]._num_children == 0) {
+	if (num_levels != -1 && num_levels != depth[i]) {
+	  std::cerr<<"Tree of caches: all leaves must be at the same depth, "
+		   <<"pad with single-child nodes"<<std::endl;
+	  exit(-1);
+	}
+	num_levels = depth[i];
+	++num_leaves;
+      }
+    }
+    if (next != num_nodes || num_leaves < _num_threads) {
+      std::cerr<<"Tree of caches: "<<num_nodes<<" nodes describe "<<next
+	       <<" nodes and "<<num_leaves<<" leaves for "<<_num_threads<<" threads"<<std::endl;
+      exit(-1);
+    }
+    if (num_levels > MAX_CACHE_LEVELS) {
+      std::cerr<<"Tree of caches: "<<num_levels<<" levels, at most "<<MAX_CACHE_LEVELS
+	       <<" (MAX_CACHE_LEVELS in knobs.hh)"<<std::endl;
+      exit(-1);
+    }
+    _tree->_num_levels = num_levels;
+    _tree->_num_leaves = num_leaves;
+    _tree->_num_clusters = num_nodes;
+
+    _tree->_sigmas = new double[num_levels+1];
+    _tree->_mus = new double[num_levels+1];
+    for (int l=0; l<=num_levels; ++l) {
+      _tree->_sigmas[l] = SIGMA;
+      _tree->_mus[l] = MU;
+    }
+    _tree->_level_offsets = new int[num_levels+2];
+    for (int l=0, i=0; l<=num_levels+1; ++l) {
+      while (i<num_nodes && depth[i]<l) ++i;
+      _tree->_level_offsets[l] = i;
+    }
+
+    // max_below[i*(num_levels+1)+k]: largest cache at k levels below node i
+    lluint * max_below = new lluint[num_nodes*(num_levels+1)];
+    for (int i=num_nodes-1; i>=0; --i) {
+      lluint * row = max_below + i*(num_levels+1);
+      row[0] = nodes[i]._size;
+      for (int k=1; k<=num_levels; ++k) {
+	row[k] = 0;
+	for (int c=0; c<nodes[i]._num_children; ++c) {
+	  lluint below = max_below[(first_child[i]+c)*(num_levels+1) + k-1];
+	  if (below > row[k]) row[k] = below;
+	}
+      }
+    }
+
+    _tree->_clusters = (Cluster*) aligned_alloc (CACHE_LINE_SIZE,
+						 _tree->_num_clusters * sizeof(Cluster));
+    for (int i=0; i<num_nodes; ++i) {
+      int l = depth[i];
+      Cluster * cur = _tree->_clusters + i;
+      Cluster * par = parent[i]==-1 ? NULL : _tree->_clusters + parent[i];
+      int sibling_id = parent[i]==-1 ? -1 : i-first_child[parent[i]];
+      if (l < num_levels) {
+	// The root (RAM) is unbounded unless a budget was given
+	lluint size = l>0 ? nodes[i]._size : (_root_budget>0 ? _root_budget : (1L<<45));
+	new (cur) Cluster (size, nodes[i]._block_size,
+			   nodes[i]._num_children, sibling_id, l, par);
+	cur->_children = _tree->_clusters + first_child[i];
+	cur->_buckets = new BucketSet (num_levels-l, l==0 ? 0 : nodes[i]._size,
+				       nodes[i]._block_size, max_below + i*(num_levels+1),
+				       nodes[i]._num_children, _tree->_sigmas+l);
+      } else {
+	new (cur) Cluster (0, 1, 1, sibling_id, l, par); // L0 cache/register
+      }
+    }
+    delete [] max_below;
+
+    // Give the first SIZE_PROFILE_SLOTS distinct block sizes a profile slot,
+    // clusters with any other block size ask the job directly
+    for (int i=0; i<num_nodes; ++i) {
+      Cluster * cur = _tree->_clusters + i;
+      for (int k=0; k<_num_profile_slots; ++k)
+	if (_profile_block_sizes[k] == (int)cur->_block_size)
+	  cur->_size_slot = k;
+      if (cur->_size_slot == -1 && _num_profile_slots < SIZE_PROFILE_SLOTS) {
+	_profile_block_sizes[_num_profile_slots] = cur->_block_size;
+	cur->_size_slot = _num_profile_slots++;
+      }
+      if (cur->_buckets != NULL)
+	cur->_buckets->set_size_slot (cur->_size_slot);
+    }
+    delete [] depth;
+    delete [] first_child;
+    delete [] parent;
+
+    int stride = CACHE_LINE_SIZE/sizeof(Cluster*);
+    _tree->_ancestor_stride = stride * ((num_levels+1+stride-1)/stride);
+    _tree->_ancestors = (Cluster**) aligned_alloc (CACHE_LINE_SIZE, _tree->_num_leaves
+						   * _tree->_ancestor_stride * sizeof(Cluster*));
+    for (int t=0; t<_tree->_num_leaves; ++t) {
+      Cluster ** anc = _tree->_ancestors + t*_tree->_ancestor_stride;
+      anc[0] = _tree->_clusters + _tree->_level_offsets[num_levels] + t;
+      for (int h=1; h<=num_levels; ++h)
+	anc[h] = anc[h-1]->_parent;
+      if (t < _num_threads)
+	for (int h=0; h<=num_levels; ++h)
+	  anc[h]->_active_leaves = anc[h]->_active_leaves + 1;
+    }
+  }
+
+  void delete_tree () {
+    for (int i=0; i<_tree->_num_clusters; ++i)
+      _tree->_clusters[i].~Cluster ();
+    free (_tree->_clusters);
+    free (_tree->_ancestors);
+    delete [] _tree->_level_offsets;
+  }
+};
+
+// Occupancy is updated under the cluster locks, taken from leaf to root
+// (HR2, HR4). _occupied is volatile for the lock-free readers, so it is
+// read and written explicitly here rather than with += .
+struct LockedReservation {
+  // A task is admitted at the root if it fits, or if the root is empty
+  template <class S>
+  static bool reserve_root (S * s, HR2Job * job) {
+    typename S::Cluster * root = s->root();
+    lluint task_size = s->job_size (job, root);
+    root->lock ();
+    if (root->_occupied > 0 && task_size > root->_size-root->_occupied) {
+      root->unlock ();
+      return false;
+    }
+    s->pin (job, root);
+    root->_occupied = root->_occupied + task_size;
+    root->unlock ();
+    return true;
+  }
+
+  // On a reject, reject_level is set to the level of the cluster that refused
+  template <class S>
+  static bool fit (S * s, HR2Job * job, int thread_id, int height, int bucket_level,
+		   int * reject_level) {
+    typename S::Cluster ** anc = s->ancestors (thread_id);
+    int top = height-bucket_level;
+
+    for (int h=0; h<top; ++h) {
+      s->lock (anc[h], thread_id);
+      if (anc[h]->_occupied > (1-s->mu (anc[h]))*(double)anc[h]->_size) {
+	s->release_locks (thread_id);
+	*reject_level = anc[h]->_level;
+	return false;
+      }
+    }
+
+    typename S::Cluster * cur = anc[top];
+
+    if (bucket_level > 0) {
+      assert (!job->is_cont_job());
+      lluint task_size = s->job_size (job, cur);
+      s->lock (cur, thread_id);
+      if (task_size > cur->_size-cur->_occupied) {
+	s->release_locks (thread_id);
+	*reject_level = cur->_level;
+	return false;
+      }
+      s->pin (job, cur);
+      assert (job->is_maximal());
+      cur->_occupied = cur->_occupied + task_size;
+    } else {
+      assert (job->get_pin_cluster() == cur);
+    }
+
+    for (int h=0; h<top; ++h) {
+      assert (s->has_lock (anc[h], thread_id));
+      anc[h]->_occupied = anc[h]->_occupied + s->strand_share (job, anc[h], h);
+    }
+
+    s->release_locks (thread_id);
+    return true;
+  }
+
+  template <class S>
+  static void charge (S * s, typename S::Cluster * cluster, lluint bytes, int thread_id) {
+    s->lock (cluster, thread_id);
+    cluster->_occupied = cluster->_occupied + bytes;
+    s->release_locks (thread_id);
+  }
+
+  template <class S>
+  static void release (S * s, HR2Job * job, int thread_id, bool deactivate) {
+    typename S::Cluster ** anc = s->ancestors (thread_id);
+    typename S::Cluster * pin = (typename S::Cluster*) job->get_pin_cluster();
+
+    /* Update occupied size */
+    int h=0;
+    for ( ; anc[h]!=pin; ++h) {
+      s->lock (anc[h], thread_id);
+      anc[h]->_occupied = anc[h]->_occupied - job->share (h);
+    }
+    typename S::Cluster * cur = anc[h];
+
+    /* If the done task started a pin, clean up the allocation */
+    if (deactivate && job->is_maximal()) {
+      s->lock (cur, thread_id);
+      cur->_occupied = cur->_occupied - s->job_size (job, cur);
+    }
+    s->release_locks (thread_id);
+  }
+};
+
+// Occupancy is updated with compare-and-swap, no cluster locks (HR3).
+// Strand shares are charged below the pin and the task size at the pin,
+// exactly as LockedReservation does, so the two can be compared directly.
+struct AtomicReservation {
+  template <class S>
+  static bool reserve_root (S * s, HR2Job * job) {
+    typename S::Cluster * root = s->root();
+    lluint task_size = s->job_size (job, root);
+    while (true) {
+      lluint occ = root->_occupied;
+      if (occ > 0 && task_size > root->_size-occ)
+	return false;
+      if (__sync_bool_compare_and_swap (&root->_occupied, occ, occ+task_size))
+	break;
+    }
+    s->pin (job, root);
+    return true;
+  }
+
+  // Add a strand share if the cluster is not above its (1-MU) watermark
+  template <class C>
+  static bool try_reserve_strand (C * cluster, lluint bytes, double mu) {
+    while (true) {
+      lluint occ = cluster->_occupied;
+      if (occ > (1-mu)*(double)cluster->_size)
+	return false;
+      if (__sync_bool_compare_and_swap (&cluster->_occupied, occ, occ+bytes))
+	return true;
+    }
+  }
+
+  // Add a task footprint if it fits in what is left of the cluster
+  template <class C>
+  static bool try_reserve_task (C * cluster, lluint bytes) {
+    while (true) {
+      lluint occ = cluster->_occupied;
+      if (occ > cluster->_size || bytes > cluster->_size-occ)
+	return false;
+      if (__sync_bool_compare_and_swap (&cluster->_occupied, occ, occ+bytes))
+	return true;
+    }
+  }
+
+  template <class S>
+  static bool fit (S * s, HR2Job * job, int thread_id, int height, int bucket_level,
+		   int * reject_level) {
+    typename S::Cluster ** anc = s->ancestors (thread_id);
+    int top = height-bucket_level;
+
+    /* First dry run */
+    for (int h=0; h<top; ++h)
+      if (anc[h]->_occupied > (1-s->mu (anc[h]))*(double)anc[h]->_size) {
+	*reject_level = anc[h]->_level;
+	return false;
+      }
+
+    typename S::Cluster * cur = anc[top];
+
+    lluint task_size = 0;
+    if (bucket_level > 0) {
+      assert (!job->is_cont_job());
+      task_size = s->job_size (job, cur);
+      if (!try_reserve_task (cur, task_size)) {
+	*reject_level = cur->_level;
+	return false;
+      }
+    } else {
+      assert (job->get_pin_cluster() == cur);
+    }
+
+    /* Then try to actually reserve */
+    for (int h=0; h<top; ++h) {
+      if (!try_reserve_strand (anc[h], s->strand_share (job, anc[h], h), s->mu (anc[h]))) {
+	/* Restore */
+	for (int u=0; u<h; ++u)
+	  __sync_fetch_and_sub (&anc[u]->_occupied, job->share (u));
+	if (bucket_level > 0)
+	  __sync_fetch_and_sub (&cur->_occupied, task_size);
+	*reject_level = anc[h]->_level;
+	return false;
+      }
+    }
+
+    if (bucket_level > 0)
+      s->pin (job, cur);
+    return true;
+  }
+
+  template <class S>
+  static void charge (S * s, typename S::Cluster * cluster, lluint bytes, int thread_id) {
+    __sync_fetch_and_add (&cluster->_occupied, bytes);
+  }
+
+  template <class S>
+  static void release (S * s, HR2Job * job, int thread_id, bool deactivate) {
+    typename S::Cluster ** anc = s->ancestors (thread_id);
+    typename S::Cluster * pin = (typename S::Cluster*) job->get_pin_cluster();
+
+    int h=0;
+    for ( ; anc[h]!=pin; ++h)
+      __sync_fetch_and_sub (&anc[h]->_occupied, job->share (h));
+    typename S::Cluster * cur = anc[h];
+
+    if (deactivate && job->is_maximal())
+      __sync_fetch_and_sub (&cur->_occupied, s->job_size (job, cur));
+  }
+};
+
+typedef HRTScheduler<LockedReservation, Buckets<HR2Job*> >         HR2Scheduler;
+typedef HRTScheduler<LockedReservation, TopDistrBuckets<HR2Job*> > HR2TopScheduler;
+typedef HRTScheduler<AtomicReservation, TopDistrBuckets<HR2Job*> > HR3Scheduler;
+typedef HRTScheduler<LockedReservation, DistrBuckets<HR2Job*> >    HR4Scheduler;
+
+#endif
@@ -1,22 +1,57 @@
 #include "Job.hh"
 #include "Fork.hh"
 #include "ThreadPool.hh"
+#include "Cancel.hh"
+
+volatile uint job_counter = 1;
+__thread uint job_id_next = 0;
+__thread uint job_id_end = 0;
+__thread PoolThr * current_thread = NULL;
+
+#if LEAK_CHECK
+volatile long num_live_jobs = 0;
+volatile long num_live_forks = 0;
+#endif
 
 void
 Job::run () {
+  PoolThr * thr = current_thread;
   function ();
+  if (thr->reused (this))                      // No longer ours to look at
+    return;
   if (!_fork_or_sync)
     std::cerr<<"Job finished with out forking or syncing"<<std::endl;
 }
 
 void
 Job::fork (int num_jobs, Job **children, 
-	   Job *cont_job) {
+	   Job *cont_job, int num_ready) {
   _fork_or_sync = true;
-  Fork* new_fork = new Fork (_parent_fork, this,
+  if (cont_job != NULL && cont_job != this) {  // The continuation carries on with our temporaries
+    cont_job->_scratch = _scratch;
+    _scratch = NULL;
+  }
+  Fork* parent_fork = _parent_fork;
+  if (!_delete && cont_job != NULL && cont_job != this) {
+    // Someone may sync on this job, which is only done once its last
+    // continuation joins. That join goes to a fork of no children, which
+    // completes the job and joins for it.
+    parent_fork = new Fork (_parent_fork, this, 0, new Job*[0], NULL);
+    parent_fork->_thr = current_thread;
+    parent_fork->_completes = this;
+    current_thread->reuse_job (this);          // May be freed as soon as it completes
+  }
+  Fork* new_fork = new Fork (parent_fork, this,
 			     num_jobs, children,
-			     cont_job );
-  new_fork->spawn(_thread);
+			     cont_job, num_ready,
+			     current_thread->take_scope () );
+  if (cont_job == this) {                      // Run again when the children join, as a continuation
+    _id = new_job_id ();
+    _executed = false;
+    _fork_or_sync = false;                     // The next stage must fork or join again
+    current_thread->reuse_job (this);
+  }
+  new_fork->spawn(current_thread);
 }
 
 void
@@ -36,40 +71,111 @@ Job::unary_fork (Job* child,
   fork (1, new_jobs, cont_job);
 }
 
+Fork*
+Job::hold () {
+  _fork_or_sync = true;
+  Fork* hold = new Fork (_parent_fork, this, 0, new Job*[0], this);
+  hold->hold ();                               // Released by resume
+  _id = new_job_id ();
+  _executed = false;
+  _fork_or_sync = false;
+  current_thread->reuse_job (this);
+  return hold;
+}
+
+void
+Job::wait (Fork * hold) {
+  hold->spawn (current_thread);
+}
+
+void
+Job::resume (Fork * hold) {
+  hold->release (current_thread);
+}
+
 void
 Job::join () {
   _fork_or_sync = true;
+  if (_scratch != NULL) {
+    Scheduler * sched = current_thread->get_pool()->_scheduler;
+    sched->charge_scratch (_scratch, -(lluint)_scratch->unreserved(), current_thread->thread_no());
+    _scratch->release ();
+    delete _scratch;
+    _scratch = NULL;
+  }
   if (_parent_fork != NULL) {
     _parent_fork->join ( this );
   } else {
-    _thread->get_pool()->done_job (this, _thread, true);
-    _thread->get_pool()->reset_null_join();
+    current_thread->get_pool()->done_job (this, current_thread, true);
+    current_thread->get_pool()->reset_null_join();
 //    std::cout<<"Joining to a null fork"<<std::endl;
   }
 }
 
-Job*
-SizedJob::cast (Job *job, bool exit_on_fail) {
-  SizedJob * j = dynamic_cast<SizedJob*>(job);
-  if (j==NULL) {
-    if (exit_on_fail) {
-      std::cerr<<"Error: HR_Scheduler needs a job of type SizedJob"<<std::endl;
-      exit(-1);
-    } else {
-      return NULL;
-    }
-  } else {
-    return j;
+void*
+Job::scratch (lluint bytes) {
+  Scheduler * sched = current_thread->get_pool()->_scheduler;
+  if (_scratch == NULL) {
+    _scratch = new ScratchArena;
+    sched->open_scratch (_scratch, this);
+  }
+  size_t charged = _scratch->unreserved();
+  void * p = _scratch->alloc (bytes);
+  if (p == NULL) {
+    std::cerr<<"Error: could not allocate "<<bytes<<" bytes of scratch memory"<<std::endl;
+    exit(-1);
   }
+  sched->charge_scratch (_scratch, _scratch->unreserved()-charged, current_thread->thread_no());
+  return p;
+}
+
+bool
+Job::workers_hungry () {
+  return current_thread->get_pool()->_num_hungry > 0;
+}
+
+void
+Job::open_scope (CancelScope * scope) {
+  current_thread->open_scope (scope);
+}
+
+CancelScope*
+Job::scope () {
+  return _parent_fork==NULL ? NULL : _parent_fork->_scope;
+}
+
+bool
+Job::cancelled () {
+  CancelScope * s = scope ();
+  return s != NULL && s->cancelled ();
 }
 
 void
 SizedJob::fork(int num_jobs, Job **children, 
-	       Job *cont_job) {
-  ((SizedJob*)cast(cont_job))->_pin_id = _pin_id;
+	       Job *cont_job, int num_ready) {
+  kind(cont_job)->_pin_id = _pin_id;
   
   for (int i=0; i<num_jobs; ++i)
-    ((SizedJob*)cast(children[i]))->_pin_id = _pin_id;
+    kind(children[i])->_pin_id = _pin_id;
     
-  Job::fork (num_jobs, children, cont_job);
+  Job::fork (num_jobs, children, cont_job, num_ready);
+}
+
+void
+SizedJob::binary_fork (SizedJob* child0, SizedJob* child1,
+		       SizedJob* cont_job) {
+  cont_job->_pin_id = child0->_pin_id = child1->_pin_id = _pin_id;
+  Job** new_jobs = new Job*[2];
+  new_jobs[0] = child0;
+  new_jobs[1] = child1;
+  Job::fork (2, new_jobs, cont_job);
+}
+
+void
+SizedJob::unary_fork (SizedJob* child,
+		      SizedJob* cont_job) {
+  cont_job->_pin_id = child->_pin_id = _pin_id;
+  Job** new_jobs = new Job*[1];
+  new_jobs[0] = child;
+  Job::fork (1, new_jobs, cont_job);
 }
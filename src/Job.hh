@@ -28,67 +28,151 @@
 #define __JOB_HH
 
 #include "Thread.hh"
+#include "Footprint.hh"
+#include "knobs.hh"
 #include "math.h"
 #include <stdint.h>
+#include <assert.h>
 
 class PoolThr;
 class Fork;
 class Job;
+class ScratchArena;
+class CancelScope;
 
 typedef unsigned int uint;
 //typedef long long unsigned int lluint;
 typedef long long int lluint;
 
-static volatile int job_counter=0;
+// Ids are handed out in blocks, so that creating a job touches no shared
+// line. They are 32 bits and only compared for equality; they wrap after
+// 4G jobs, which no scheduler keeps that many of alive.
+#define JOB_ID_BLOCK 1024
+extern volatile uint job_counter;               // Defined in Job.cc
+extern __thread uint job_id_next;
+extern __thread uint job_id_end;
+extern __thread PoolThr * current_thread;       // Worker running jobs on this thread
+#if LEAK_CHECK
+extern volatile long num_live_jobs;
+extern volatile long num_live_forks;
+#endif
+
+inline uint
+new_job_id () {
+  if (job_id_next == job_id_end) {
+    job_id_next = __sync_fetch_and_add (&job_counter, JOB_ID_BLOCK);
+    job_id_end = job_id_next + JOB_ID_BLOCK;
+  }
+  return job_id_next++;
+}
+
 // class for a job in the pool
+// Kept to 40 bytes so that most jobs fit a cache line with their payload;
+// state only some schedulers need lives in the derived classes.
 class Job {
   friend class Fork;
-public:
-  Mutex              _sync_mutex;              // mutex for synchronisation
-
-  lluint             _id;                      // Unique id, up to scheduler to use this
-  
+protected:
   Fork	       *     _parent_fork;             // Fork that spawned this job, used to sync to or pass on to children
-  lluint             _strand_id;               // Which job_id started this job
-  
-  PoolThr      *     _thread;
+  ScratchArena *     _scratch;                 // Temporaries of this strand and its continuations
+  uint               _id;                      // Unique id, up to scheduler to use this
+  uint               _strand_id;               // Which job_id started this job
   bool               _fork_or_sync;            // Did this job fork or sync at the end?
   bool               _delete;                  // Delete after completion? This feature can be used to keep root with out deletion??
 
 public:
-  int               _executed;                // Has the job been executed
+  bool               _executed;                // Has the job been executed
+protected:
+  unsigned char      _priority;                // Class of the root, inherited by its descendants
+public:
+  uint               _queued_at;               // When it was last enqueued, in us (_log)
 
   Job ( bool del = true )
     : _parent_fork (NULL),
+      _scratch (NULL),
+      _id (new_job_id ()),
       _strand_id (-1),
-      _thread (NULL),
       _fork_or_sync (false),
       _delete (del),
-      _executed (0)
+      _executed (false),
+      _priority (0),
+      _queued_at (0)
     {
-        _id = __sync_add_and_fetch(&job_counter, 1);
+#if LEAK_CHECK
+        __sync_fetch_and_add(&num_live_jobs, 1);
+#endif
     }
   virtual ~Job () {
-    //Need to delete job
-    if ( _sync_mutex.is_locked() )
-      std::cerr << "(Job) destructor : job is still running!" << std::endl;
+#if LEAK_CHECK
+    __sync_fetch_and_sub(&num_live_jobs, 1);
+#endif
   }
 
   virtual void function() = 0;
   
   void     run         ();
+  // The Fork takes over children, which must come from new[]; it is
+  // deleted with the Fork once the continuation has been enqueued.
+  // cont_job may be this job: advance its stage before forking, and it
+  // runs again once the children join, without a new job being allocated.
+  // Its strand_size must not depend on the stage, since the strand that
+  // forked is released after the stage has changed, and function() must
+  // not touch the job after the fork, it may already be running again.
+  // Only the first num_ready children (all, if -1) are enqueued by the
+  // fork; the rest wait until a sibling enqueues them, see FutureJob.
+  // A job kept for tp_sync (del=false) is executed once its last
+  // continuation joins; it too must not be touched after the fork.
   virtual
-  void     fork        (int num_jobs, Job **children, Job *cont_job);
+  void     fork        (int num_jobs, Job **children, Job *cont_job,
+			int num_ready=-1);
   void     binary_fork (Job* child0, Job* child1, Job *cont_job);
   void     unary_fork  (Job* child, Job *cont_job);
   void     join        ();
 
+  // Suspend this job without forking children: hold() ends the strand
+  // and returns a handle, which the caller publishes before passing it
+  // to wait(). The job runs again, as its own continuation, once some
+  // other job calls resume() on the handle; resume() may come first.
+  // As with a fork, the job must not be touched once the handle is
+  // published.
+  Fork *   hold        ();
+  void     wait        (Fork * hold);
+  static
+  void     resume      (Fork * hold);
+
+  // Scratch memory for temporaries, valid until the last continuation of
+  // this job joins, where it is released all at once. Children get arenas
+  // of their own but may use what their parent allocated. A SizedJob's
+  // size() should count its scratch: the space-bounded schedulers only
+  // charge the pinned cluster for what goes beyond it.
+  void *   scratch     (lluint bytes);
+
+  // Is some worker out of work? Jobs that can choose how finely to split
+  // themselves, like Pfor, only split further while this holds.
+  bool     workers_hungry ();
+
+  // Cancellation, see Cancel.hh. open_scope puts the children of the next
+  // fork on this thread in scope, so call it right before the fork.
+  // cancelled() is cheap enough to poll in the loops of a running job.
+  void          open_scope (CancelScope * scope);
+  CancelScope * scope      ();
+  bool          cancelled  ();
+  // Run instead of function() when a worker dequeues the task after its
+  // scope was cancelled. Override it if the task's join does more, as
+  // FutureJob's does.
   virtual
-  Job*     cast        () { return this; }                   // In derived classes, check if object is of derived class
-  
+  void          skip       () {join ();}
+
+  // Priority class, 0 to NUM_PRIORITIES-1, higher classes are served
+  // first. Set it on a root before tp_run, the jobs it forks inherit it.
+  void     set_priority (int priority) {
+    assert (priority >= 0 && priority < NUM_PRIORITIES);
+    _priority = priority;
+  }
+  int      priority    () { return _priority;}
+
   bool     deletable   () { return _delete;}
-  void     set_thread  (PoolThr* thr) {_thread=thr;}
-  PoolThr* get_thread  () {return _thread;}
+  bool     executed    () { return *(volatile bool*)&_executed;} // Read by sync while the job runs
+  PoolThr* get_thread  () {return current_thread;}
 
   void     set_id      (lluint id) {_id=id;}
   lluint   get_id      () {return _id;}
@@ -97,26 +181,46 @@ public:
   lluint   strand_id   () {return _strand_id;}
   bool     is_cont_job () {return _id!=_strand_id;}      // If this Job a continuation strand in a job
   
-  // Mutex
-  void     lock        () {}// std::cout << "Job " << _id << " lock" << std::endl; _sync_mutex.lock(); }
-  void     unlock      () {}// std::cout << "Job " << _id << " unlock" << std::endl;  _sync_mutex.unlock(); }
+  // Jobs are not locked, these are kept for the callers that still do
+  void     lock        () {}
+  void     unlock      () {}
 };
 
 class SizedJob : public Job {
-  lluint              _pin_id;
+protected:
+  union {                                       // Where the job is pinned, each scheduler uses one
+    lluint            _pin_id;                  // HR1: id of the job that pinned it
+    void*             _pin_cluster;             // HRT: should be typed HRTScheduler<>::Cluster*
+  };
 public:
   SizedJob (bool del = true)
     : Job (del),
       _pin_id(-1)
     {}
   
+  // The pin is handed down to the children and the continuation. The
+  // typed forks take SizedJobs, so that no cast is needed and passing
+  // another kind of job does not compile; the Job** fork is kept for
+  // arrays built by generic code and checks the kind of each job as it goes.
   void     fork        (int num_jobs, Job **children,
-			Job *cont_job);
-  
-  Job*     cast        (Job* job, bool exit_on_fail=true); // Over ride exit_on_fail if you want program to continue running despite a negative result
+			Job *cont_job, int num_ready=-1);
+  void     binary_fork (SizedJob* child0, SizedJob* child1, SizedJob *cont_job);
+  void     unary_fork  (SizedJob* child, SizedJob *cont_job);
+
+  static SizedJob* kind (Job* job) {
+    SizedJob * j = dynamic_cast<SizedJob*>(job);
+    if (j == NULL) {
+      std::cerr<<"Error: HR_Scheduler needs a job of type SizedJob"<<std::endl;
+      exit(-1);
+    }
+    return j;
+  }
   
   virtual  lluint size (const int block_size) = 0;
-   inline   lluint round_up (lluint size, const int block_size) {
+  // Optional: fill in up to max_ranges address ranges the task will read or
+  // write and return how many. Used to warm the cache a task is pinned to.
+  virtual  int    footprint (MemRange *ranges, int max_ranges) {return 0;}
+  static inline lluint round_up (lluint size, const int block_size) {
     return (lluint)ceil(((double)size/(double)block_size))*block_size;
   }
 
@@ -137,50 +241,96 @@ typedef class HR2Job : public SizedJob {
 
   #define        STRAND_SIZE 100    // Check and update these numbers with the real values
   
-  void*       _pin_cluster; // This and the following should be typed HR2Scheduler::Cluster*
-  void*       _parent_pin_cluster;
+  bool        _maximal;     // Pinned to a cluster its parent was not pinned to
+  // size() and strand_size() for each block size of the tree, filled in by
+  // the scheduler when the job is added. Strand sizes saturate at 4GB, the
+  // share a strand is charged on a cache is capped far below that.
+  uint        _strand_sizes[SIZE_PROFILE_SLOTS];
+  lluint      _task_sizes[SIZE_PROFILE_SLOTS];
+  // Share of each cache above its thread the running strand was charged,
+  // by height. Released as charged, MU may have changed in between.
+  uint        _shares[MAX_CACHE_LEVELS];
 public:
   HR2Job (bool del = true)
     : SizedJob (del),
-      _pin_cluster(NULL),
-      _parent_pin_cluster(NULL)
-    {}
+      _maximal(false)
+    {
+      _pin_cluster = NULL;
+    }
 
   virtual lluint strand_size (const int block_size)=0;
   
-  void fork (int num_jobs, Job **children, Job *cont_job) {
-    ((HR2Job*)cast(cont_job))->_pin_cluster = _pin_cluster;
-    ((HR2Job*)cast(cont_job))->_parent_pin_cluster = _parent_pin_cluster;
-    
-    for (int i=0; i<num_jobs; ++i) {
-      ((HR2Job*)cast(children[i]))->_pin_cluster = _pin_cluster;
-      ((HR2Job*)cast(children[i]))->_parent_pin_cluster = _pin_cluster;
-    }
+  // As for SizedJob, the typed forks are checked by the compiler and the
+  // Job** one at run time.
+  void fork (int num_jobs, Job **children, Job *cont_job, int num_ready=-1) {
+    continue_in (kind (cont_job));
+    for (int i=0; i<num_jobs; ++i)
+      inherit (kind (children[i]), false);
 
-    Job::fork (num_jobs, children, cont_job);
+    Job::fork (num_jobs, children, cont_job, num_ready);
   }
-  
-  Job* cast (Job* job, bool exit_on_fail=true) {
-    HR2Job* j = dynamic_cast<HR2Job*>(job);
-    if (j==NULL) {
+
+  void binary_fork (HR2Job* child0, HR2Job* child1, HR2Job *cont_job) {
+    continue_in (cont_job);
+    inherit (child0, false);
+    inherit (child1, false);
+    Job** children = new Job*[2];
+    children[0] = child0;
+    children[1] = child1;
+    Job::fork (2, children, cont_job);
+  }
+
+  void unary_fork (HR2Job* child, HR2Job *cont_job) {
+    continue_in (cont_job);
+    inherit (child, false);
+    Job** children = new Job*[1];
+    children[0] = child;
+    Job::fork (1, children, cont_job);
+  }
+
+  static HR2Job* kind (Job* job) {
+    HR2Job * j = dynamic_cast<HR2Job*>(job);
+    if (j == NULL) {
       std::cerr<<"Error: HR_Scheduler needs a job of type HR2Job"<<std::endl;
       exit(-1);
-    } else {
-      return j;
     }
+    return j;
   }
 
   bool is_maximal() {
-     return (_pin_cluster != _parent_pin_cluster);
+     return _maximal;
   }
 
-  bool is_parent_pin_null () {
-    return _parent_pin_cluster==NULL;
-  }
+  void  pin_to_cluster  (void* cluster, lluint size) {_pin_cluster = cluster; _maximal = true;}
 
-  void  pin_to_cluster  (void* cluster, lluint size) {_pin_cluster = cluster; }
+  void   set_profile          (int slot, lluint task_size, lluint strand_size) {
+    _task_sizes[slot] = task_size;
+    _strand_sizes[slot] = strand_size < (uint)-1 ? strand_size : (uint)-1;
+  }
+  lluint profiled_size        (int slot) {return _task_sizes[slot];}
+  lluint profiled_strand_size (int slot) {return _strand_sizes[slot];}
+  void   set_share            (int height, lluint share) {_shares[height] = share;}
+  lluint share                (int height) {return _shares[height];}
   void* get_pin_cluster  () {return _pin_cluster;}
 
+private:
+  void  inherit         (HR2Job* job, bool maximal) {
+    job->_pin_cluster = _pin_cluster;
+    job->_maximal = maximal;
+  }
+
+  // The continuation carries on the task, so it keeps the profile it was
+  // pinned with; the schedulers only profile jobs that start a task.
+  void  continue_in     (HR2Job* cont) {
+    inherit (cont, _maximal);
+    if (cont == this)
+      return;
+    for (int i=0; i<SIZE_PROFILE_SLOTS; ++i) {
+      cont->_task_sizes[i] = _task_sizes[i];
+      cont->_strand_sizes[i] = _strand_sizes[i];
+    }
+  }
+
 } HR2Job;
 
 
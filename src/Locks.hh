@@ -0,0 +1,332 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __LOCKS_HH
+#define __LOCKS_HH
+
+// Spin and queue locks with the same lock/unlock/is_locked interface as
+// Mutex, so that a lock type can be chosen per use site:
+//
+//   TTASLock   : test-and-test-and-set with exponential backoff
+//   TicketLock : FIFO ticket lock with proportional backoff
+//   MCSLock    : queue lock, each waiter spins on its own node
+//   CLHLock    : queue lock, each waiter spins on its predecessor's node
+//
+// Each lock counts acquisitions, contended acquisitions, spin iterations
+// and cycles spent waiting. The counters are updated by the holder, so
+// they need no atomics; the uncontended path only bumps one counter.
+
+#include "Thread.hh"
+#include <iostream>
+#include <assert.h>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#ifndef LOCK_STATS
+#define LOCK_STATS 1
+#endif
+
+#define TTAS_MIN_BACKOFF   4
+#define TTAS_MAX_BACKOFF   1024
+#define TICKET_BACKOFF     32                     // Pauses per ticket ahead of us
+
+inline void cpu_relax () {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause ();
+#endif
+}
+
+inline unsigned long long lock_ticks () {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc ();
+#else
+  return 0;
+#endif
+}
+
+struct LockStats {
+  unsigned long long   _acquires;
+  unsigned long long   _contended;                // Acquisitions that had to wait
+  unsigned long long   _spins;
+  unsigned long long   _wait_ticks;
+
+  LockStats () : _acquires (0), _contended (0), _spins (0), _wait_ticks (0) {}
+
+  void add (const LockStats & other) {
+    _acquires += other._acquires;
+    _contended += other._contended;
+    _spins += other._spins;
+    _wait_ticks += other._wait_ticks;
+  }
+
+  void print (const char * name) const {
+    std::cout<<name<<": acquires "<<_acquires
+	     <<", contended "<<_contended
+	     <<", spins "<<_spins
+	     <<", wait ticks "<<_wait_ticks<<std::endl;
+  }
+};
+
+// Lock-side bookkeeping, compiled out with LOCK_STATS 0
+class StatLock {
+protected:
+  LockStats            _stats;
+
+  void acquired () {
+#if LOCK_STATS == 1
+    ++_stats._acquires;
+#endif
+  }
+  void waited (unsigned long long start, unsigned long long spins) {
+#if LOCK_STATS == 1
+    ++_stats._contended;
+    _stats._spins += spins;
+    _stats._wait_ticks += lock_ticks () - start;
+#endif
+  }
+  unsigned long long wait_start () {
+#if LOCK_STATS == 1
+    return lock_ticks ();
+#else
+    return 0;
+#endif
+  }
+
+public:
+  const LockStats & stats () const {return _stats;}
+  void reset_stats () {_stats = LockStats ();}
+};
+
+// Mutex keeps no statistics
+inline LockStats lock_stats (const Mutex &) {return LockStats ();}
+template <class L>
+inline LockStats lock_stats (const L & l) {return l.stats ();}
+
+
+class TTASLock : public StatLock {
+protected:
+  volatile int         _flag;
+
+public:
+  TTASLock () : _flag (0) {}
+
+  int lock () {
+    if (__sync_lock_test_and_set (&_flag, 1) == 0) {
+      acquired ();
+      return 0;
+    }
+    unsigned long long start = wait_start (), spins = 0;
+    int backoff = TTAS_MIN_BACKOFF;
+    while (true) {
+      while (_flag) {
+	cpu_relax ();
+	++spins;
+      }
+      if (__sync_lock_test_and_set (&_flag, 1) == 0)
+	break;
+      for (int i=0; i<backoff; ++i)
+	cpu_relax ();
+      spins += backoff;
+      if (backoff < TTAS_MAX_BACKOFF)
+	backoff *= 2;
+    }
+    acquired ();
+    waited (start, spins);
+    return 0;
+  }
+
+  int unlock () {
+    __sync_lock_release (&_flag);
+    return 0;
+  }
+
+  bool is_locked () {return _flag != 0;}
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+
+class TicketLock : public StatLock {
+protected:
+  volatile unsigned int _next_ticket;
+  volatile unsigned int _now_serving;
+
+public:
+  TicketLock () : _next_ticket (0), _now_serving (0) {}
+
+  int lock () {
+    unsigned int ticket = __sync_fetch_and_add (&_next_ticket, 1);
+    if (_now_serving != ticket) {
+      unsigned long long start = wait_start (), spins = 0;
+      unsigned int ahead;
+      while ((ahead = ticket - _now_serving) != 0) {
+	for (unsigned int i=0; i<ahead*TICKET_BACKOFF; ++i)
+	  cpu_relax ();
+	spins += ahead*TICKET_BACKOFF;
+      }
+      waited (start, spins);
+    }
+    __sync_synchronize ();
+    acquired ();
+    return 0;
+  }
+
+  int unlock () {
+    __sync_synchronize ();
+    _now_serving = _now_serving + 1;
+    return 0;
+  }
+
+  bool is_locked () {return _now_serving != _next_ticket;}
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+
+// Queue node for MCSLock and CLHLock. A thread can hold several queue locks
+// at once (the HR schedulers lock leaf to root), so nodes come from a
+// per-thread free list rather than from a single thread-local node.
+struct LockQNode {
+  LockQNode * volatile _next;
+  volatile bool        _wait;
+  LockQNode *          _free_next;
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+inline LockQNode *& lock_qnode_free_list () {
+  static __thread LockQNode * free_list = NULL;
+  return free_list;
+}
+
+inline LockQNode * lock_qnode_alloc () {
+  LockQNode *& free_list = lock_qnode_free_list ();
+  LockQNode * node = free_list;
+  if (node == NULL)
+    return new LockQNode;
+  free_list = node->_free_next;
+  return node;
+}
+
+inline void lock_qnode_free (LockQNode * node) {
+  LockQNode *& free_list = lock_qnode_free_list ();
+  node->_free_next = free_list;
+  free_list = node;
+}
+
+
+class MCSLock : public StatLock {
+protected:
+  LockQNode * volatile _tail;
+  LockQNode *          _holder;                   // Node of the current holder
+
+public:
+  MCSLock () : _tail (NULL), _holder (NULL) {}
+
+  int lock () {
+    LockQNode * me = lock_qnode_alloc ();
+    me->_next = NULL;
+    me->_wait = true;
+    LockQNode * pred = __sync_lock_test_and_set (&_tail, me);
+    if (pred != NULL) {
+      unsigned long long start = wait_start (), spins = 0;
+      pred->_next = me;
+      while (me->_wait) {
+	cpu_relax ();
+	++spins;
+      }
+      waited (start, spins);
+    }
+    __sync_synchronize ();
+    _holder = me;
+    acquired ();
+    return 0;
+  }
+
+  int unlock () {
+    LockQNode * me = _holder;
+    if (me->_next == NULL) {
+      if (__sync_bool_compare_and_swap (&_tail, me, (LockQNode*)NULL)) {
+	lock_qnode_free (me);
+	return 0;
+      }
+      while (me->_next == NULL)
+	cpu_relax ();
+    }
+    __sync_synchronize ();
+    me->_next->_wait = false;
+    lock_qnode_free (me);
+    return 0;
+  }
+
+  bool is_locked () {return _tail != NULL;}
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+
+class CLHLock : public StatLock {
+protected:
+  LockQNode * volatile _tail;
+  LockQNode *          _holder;
+  LockQNode *          _holder_pred;              // Recycled by the holder on unlock
+
+public:
+  CLHLock () : _holder (NULL), _holder_pred (NULL) {
+    _tail = new LockQNode;
+    _tail->_wait = false;
+  }
+  ~CLHLock () {
+    delete _tail;
+  }
+
+  int lock () {
+    LockQNode * me = lock_qnode_alloc ();
+    me->_wait = true;
+    LockQNode * pred = __sync_lock_test_and_set (&_tail, me);
+    if (pred->_wait) {
+      unsigned long long start = wait_start (), spins = 0;
+      while (pred->_wait) {
+	cpu_relax ();
+	++spins;
+      }
+      waited (start, spins);
+    }
+    __sync_synchronize ();
+    _holder = me;
+    _holder_pred = pred;
+    acquired ();
+    return 0;
+  }
+
+  int unlock () {
+    LockQNode * me = _holder;
+    LockQNode * pred = _holder_pred;
+    __sync_synchronize ();
+    me->_wait = false;
+    lock_qnode_free (pred);
+    return 0;
+  }
+
+  bool is_locked () {return _tail->_wait;}
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+#endif
@@ -0,0 +1,138 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __NUMA_PLACEMENT_HH
+#define __NUMA_PLACEMENT_HH
+
+#include "Footprint.hh"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <iostream>
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1<<1)                       // From numaif.h, so we need not link libnuma
+#endif
+
+#define NUMA_MIN_BYTES   (1<<24)                  // Default: smaller tasks are not worth migrating
+#define NUMA_PAGE_BATCH  1024                     // Pages per move_pages call
+
+// Number of memory nodes the kernel reports, 1 if it reports none
+inline int numa_num_nodes () {
+  DIR * dir = opendir ("/sys/devices/system/node");
+  if (dir == NULL)
+    return 1;
+  int num_nodes = 0;
+  struct dirent * entry;
+  while ((entry = readdir (dir)) != NULL)
+    if (strncmp (entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+      ++num_nodes;
+  closedir (dir);
+  return num_nodes > 0 ? num_nodes : 1;
+}
+
+// Moves the pages of a task's footprint to a NUMA node with move_pages.
+// Only tasks of at least min_bytes are moved, so that the copy is paid
+// for by the accesses the task and its subtasks then make locally.
+// With a single node every call returns at once.
+class NumaPlacer {
+  int                 _num_nodes;
+  long                _page_size;
+  long long           _min_bytes;
+
+  struct Batch {
+    void *            _pages[NUMA_PAGE_BATCH];
+    int               _nodes[NUMA_PAGE_BATCH];
+    int               _status[NUMA_PAGE_BATCH];
+    int               _num_pages;
+  };
+
+public:
+  volatile long long  _num_tasks;                 // Tasks whose pages were moved
+  volatile long long  _num_moved;                 // Pages now on the requested node
+
+  NumaPlacer (long long min_bytes=NUMA_MIN_BYTES)
+    : _num_nodes (numa_num_nodes ()),
+      _page_size (sysconf (_SC_PAGESIZE)),
+      _min_bytes (min_bytes),
+      _num_tasks (0),
+      _num_moved (0) {}
+
+  int  num_nodes () {return _num_nodes;}
+  bool worth     (long long task_size) {return _num_nodes > 1 && task_size >= _min_bytes;}
+
+  void place (const MemRange *ranges, int num_ranges, int node) {
+    if (_num_nodes <= 1)
+      return;
+    Batch batch;
+    batch._num_pages = 0;
+    node %= _num_nodes;
+    for (int r=0; r<num_ranges; ++r) {
+      const MemRange & range = ranges[r];
+      char * last = NULL;
+      for (int row=0; row<range._count; ++row) {
+	char * start = range._start + row*range._stride;
+	char * page = (char*)((uintptr_t)start & ~(uintptr_t)(_page_size-1));
+	for ( ; page<start+range._bytes; page+=_page_size) {
+	  if (page <= last)                       // Rows sharing a page
+	    continue;
+	  last = page;
+	  batch._pages[batch._num_pages] = page;
+	  batch._nodes[batch._num_pages] = node;
+	  if (++batch._num_pages == NUMA_PAGE_BATCH)
+	    flush (batch);
+	}
+      }
+    }
+    flush (batch);
+    __sync_fetch_and_add (&_num_tasks, 1);
+  }
+
+  void print () {
+    std::cout<<"NUMA nodes: "<<_num_nodes<<", tasks placed: "<<_num_tasks
+	     <<", pages moved: "<<_num_moved<<std::endl;
+  }
+
+private:
+  void flush (Batch & batch) {
+    if (batch._num_pages == 0)
+      return;
+    if (syscall (SYS_move_pages, 0, (unsigned long)batch._num_pages, batch._pages,
+		 batch._nodes, batch._status, MPOL_MF_MOVE) == 0) {
+      int moved = 0;
+      for (int i=0; i<batch._num_pages; ++i)
+	if (batch._status[i] >= 0)
+	  ++moved;
+      __sync_fetch_and_add (&_num_moved, moved);
+    }
+    batch._num_pages = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,245 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+
+#ifndef __PIPELINE_HH
+#define __PIPELINE_HH
+
+// Pipeline over a stream of chunks. A serial source fills chunks, which
+// then go through a list of stages in order. A serial stage takes one
+// chunk at a time, in the order the source produced them; a parallel
+// stage takes any number at once. At most num_lanes chunks are in flight:
+// a lane is a task that carries one chunk at a time through all the
+// stages, so the source is held back until a lane comes free. Under the
+// HR schedulers every stage of a chunk runs in the cluster its lane is
+// pinned to, and the chunk (kept in the lane and reused) stays in its
+// cache. A lane waiting for its turn at a serial stage is suspended with
+// Job::hold, it does not keep a worker.
+
+#include "Job.hh"
+#include "Fork.hh"
+#include "ThreadPool.hh"
+#include <assert.h>
+
+template <class Chunk>
+class PipeSource {
+public:
+  virtual ~PipeSource () {}
+  // Fill chunk with the next part of the input, false once it is exhausted
+  virtual bool fill (Chunk * chunk) = 0;
+};
+
+template <class Chunk>
+class PipeStage {
+  const bool          _serial;
+public:
+  PipeStage (bool serial) : _serial (serial) {}
+  virtual ~PipeStage () {}
+  bool serial () const {return _serial;}
+  // Work of the stage on chunk. A job returned (a Map over the chunk, say)
+  // is forked where the chunk is, and the chunk moves on once it joins.
+  virtual HR2Job* process (Chunk * chunk) = 0;
+};
+
+// Lets chunks into a serial stage in the order of their sequence numbers
+class PipeGate {
+  Mutex               _mutex;
+  lluint              _next;                    // Sequence no. of the chunk let in next
+  Fork **             _waiting;                 // Holds of suspended lanes, by seq % num_lanes
+  int                 _num_lanes;
+
+public:
+  PipeGate () : _next (0), _waiting (NULL), _num_lanes (0) {}
+  ~PipeGate () {delete [] _waiting;}
+
+  void init (int num_lanes) {
+    _num_lanes = num_lanes;
+    _waiting = new Fork*[num_lanes];
+    for (int i=0; i<num_lanes; ++i)
+      _waiting[i] = NULL;
+  }
+
+  // NULL if seq may go in now, else the hold of job, resumed when it is
+  // seq's turn; the caller has to wait on it. Every chunk between _next
+  // and seq is held by a lane, so no two waiting chunks share a slot.
+  Fork * enter (lluint seq, Job * job) {
+    _mutex.lock ();
+    if (seq == _next) {
+      _mutex.unlock ();
+      return NULL;
+    }
+    assert (_waiting[seq % _num_lanes] == NULL);
+    Fork * hold = job->hold ();
+    _waiting[seq % _num_lanes] = hold;
+    _mutex.unlock ();
+    return hold;
+  }
+
+  void exit () {
+    _mutex.lock ();
+    ++_next;
+    Fork * hold = _waiting[_next % _num_lanes];
+    _waiting[_next % _num_lanes] = NULL;
+    _mutex.unlock ();
+    if (hold != NULL)
+      Job::resume (hold);
+  }
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+template <class Chunk> class Pipeline;
+
+template <class Chunk>
+class PipeLane : public HR2Job {
+  Pipeline<Chunk> *   _pipe;
+  Chunk               _chunk;
+  lluint              _seq;                     // Of the chunk in the lane
+  int                 _stage;                   // 0: the source, i: _stages[i-1]
+  bool                _entered;                 // Past the gate of _stage
+  bool                _processed;               // _stage's work is done, or forked
+
+public:
+  PipeLane (Pipeline<Chunk> * pipe, bool del=true)
+    : HR2Job (del),
+      _pipe (pipe), _seq (0), _stage (0),
+      _entered (false), _processed (false)
+    {}
+
+  lluint size (const int block_size) {
+    return round_up (_pipe->_chunk_bytes, block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1) {
+      return size (block_size);
+    } else {
+      return STRAND_SIZE;
+    }
+  }
+
+  void function () {
+    for (;;) {
+      if (!_entered) {
+	if (_stage == 0)
+	  _seq = __sync_fetch_and_add (&_pipe->_num_seqs, 1);
+	_entered = true;
+	if (_pipe->serial (_stage)) {
+	  Fork * hold = _pipe->_gates[_stage].enter (_seq, this);
+	  if (hold != NULL) {
+	    wait (hold);
+	    return;
+	  }
+	}
+      }
+
+      if (_stage == 0) {                       // Under the source's gate
+	bool more = !_pipe->_ended && _pipe->_source->fill (&_chunk);
+	if (more)
+	  ++_pipe->_num_chunks;
+	else
+	  _pipe->_ended = true;
+	_pipe->_gates[0].exit ();
+	if (!more) {
+	  join ();
+	  return;
+	}
+      } else {
+	if (!_processed) {
+	  _processed = true;
+	  HR2Job * job = _pipe->_stages[_stage-1]->process (&_chunk);
+	  if (job != NULL) {
+	    unary_fork (job, this);
+	    return;
+	  }
+	}
+	if (_pipe->serial (_stage))
+	  _pipe->_gates[_stage].exit ();
+      }
+
+      _entered = _processed = false;
+      _stage = (_stage == _pipe->_num_stages) ? 0 : _stage+1;
+    }
+  }
+};
+
+template <class Chunk>
+class Pipeline : public HR2Job {
+  friend class PipeLane<Chunk>;
+
+  PipeSource<Chunk> * _source;
+  PipeStage<Chunk> ** _stages;
+  int                 _num_stages;
+  int                 _num_lanes;
+  lluint              _chunk_bytes;             // Footprint of a chunk, as the size of a lane
+  PipeGate *          _gates;                   // _gates[0] for the source, _gates[i] for _stages[i-1]
+  volatile lluint     _num_seqs;                // Sequence numbers handed out, one per chunk a lane starts
+  lluint              _num_chunks;              // Filled by the source
+  bool                _ended;                   // Has the source run dry?
+  int                 _stage;
+
+  bool serial (int stage) {return stage == 0 || _stages[stage-1]->serial ();}
+
+public:
+  // Does not take over source, stages or the array
+  Pipeline (PipeSource<Chunk> * source, int num_stages, PipeStage<Chunk> ** stages,
+	    int num_lanes, lluint chunk_bytes, bool del=true)
+    : HR2Job (del),
+      _source (source), _stages (stages), _num_stages (num_stages),
+      _num_lanes (num_lanes), _chunk_bytes (chunk_bytes),
+      _num_seqs (0), _num_chunks (0), _ended (false), _stage (0)
+    {
+      _gates = new PipeGate [num_stages+1];
+      for (int i=0; i<=num_stages; ++i)
+	_gates[i].init (num_lanes);
+    }
+  ~Pipeline () {delete [] _gates;}
+
+  lluint size (const int block_size) {
+    return _num_lanes*round_up (_chunk_bytes, block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1) {
+      return size (block_size);
+    } else {
+      return STRAND_SIZE;
+    }
+  }
+
+  lluint num_chunks () {return _num_chunks;}
+
+  void function () {
+    if (_stage == 0) {
+      Job ** lanes = new Job*[_num_lanes];
+      for (int i=0; i<_num_lanes; ++i)
+	lanes[i] = new PipeLane<Chunk> (this);
+      _stage = 1;
+      fork (_num_lanes, lanes, this);
+    } else {
+      join ();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,111 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+
+#ifndef __REDUCER_HH
+#define __REDUCER_HH
+
+// Accumulator for a reduction spread over many jobs. Every worker folds
+// its partial results into a view of its own, so leaves neither lock nor
+// hand a heap cell to a combine job; the views are merged lazily, once,
+// when get() is called after the last job updating the reducer has joined.
+// Views are combined in no particular order: combine must be associative
+// and commutative (sum, max, max with ties broken by index, ...).
+
+#include "ThreadPool.hh"
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+
+template <class T, class Combine>
+class Reducer {
+  struct View {
+    T                 _value;
+    bool              _set;                     // Has anything been folded into _value?
+  } __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+  View *              _views;                   // One per worker, last one for other threads
+  int                 _num_views;
+  Combine             _combine;
+
+  View & view () {
+    return _views[current_thread == NULL ? _num_views-1 : current_thread->thread_no()];
+  }
+
+public:
+  Reducer (int num_workers, Combine combine=Combine())
+    : _num_views (num_workers+1),
+      _combine (combine) {
+    _views = (View*) aligned_alloc (CACHE_LINE_SIZE, _num_views*sizeof(View));
+    for (int i=0; i<_num_views; ++i)
+      new (&_views[i]) View ();
+    reset ();
+  }
+  ~Reducer () {
+    for (int i=0; i<_num_views; ++i)
+      _views[i].~View ();
+    free (_views);
+  }
+
+  void update (const T& value) {
+    View & v = view ();
+    if (v._set) {
+      v._value = _combine (v._value, value);
+    } else {
+      v._value = value;
+      v._set = true;
+    }
+  }
+
+  bool empty () {
+    for (int i=0; i<_num_views; ++i)
+      if (_views[i]._set)
+	return false;
+    return true;
+  }
+
+  // Merge of all views, must not be empty
+  T get () {
+    int i=0;
+    while (!_views[i]._set) {
+      ++i;
+      assert (i < _num_views);
+    }
+    T result = _views[i]._value;
+    for (++i; i<_num_views; ++i)
+      if (_views[i]._set)
+	result = _combine (result, _views[i]._value);
+    return result;
+  }
+
+  void reset () {
+    for (int i=0; i<_num_views; ++i)
+      _views[i]._set = false;
+  }
+};
+
+#endif
@@ -29,6 +29,7 @@
 
 #include "Job.hh"
 #include "syncQueue.hh"
+#include "ScratchArena.hh"
 #include <deque>
 #include <vector>
 #include <string>
@@ -46,10 +47,19 @@ protected:
   std::vector<Job*> _job_queue;                   // Jobs to be done
   Mutex             _queue_lock;
   pid_t *           _pthread_map;                  // Pthread ID map
+  volatile bool *   _active;                      // Threads not deactivated by set_active
+  ScratchPool       _scratch_pool;                // For schedulers without clusters
 public:
   Scheduler (int num_threads)
     : _num_threads (num_threads)//, _pool(NULL)
-    {}
+    {
+      _active = new volatile bool[num_threads];
+      for (int i=0; i<num_threads; ++i)
+	_active[i] = true;
+    }
+  virtual ~Scheduler () {
+    delete [] _active;
+  }
   bool check_range  (int id, int start, int end,
 		     std::string * func_name);    // Check if the thread id is in proper range (start inclusive, end exclusive), print error and exit otherwise
   void set_pthread_map (pid_t *map) {_pthread_map=map;}
@@ -63,6 +73,22 @@ public:
                                                   // else, check if any jobs that can be handled by this thread
                                                   // implementations of derived classes should confirm to this
   virtual void print_scheduler_stats();
+
+  // Scratch arenas (Job::scratch): pick the pool a job's arena draws from,
+  // and account for the bytes it takes (negative when it is released)
+  virtual void open_scratch   (ScratchArena *arena, Job *job) {arena->_pool = &_scratch_pool;}
+  virtual void charge_scratch (ScratchArena *arena, lluint bytes, int thread_id) {}
+
+  // The job running on thread_id blocks in tp_sync (waiting), or goes on
+  // (!waiting) once the job it synced with has executed
+  virtual void sync_wait (Job *job, int thread_id, bool waiting) {}
+
+  bool active (int thread_id) {                   // An inactive thread drains the work only it can run,
+    return _active[thread_id]; }                  // then parks once PARK_EMPTY_GETS gets in a row return NULL
+  virtual void set_active (int thread_id, bool on);
+  virtual void set_cluster_active (int level,     // Same for all threads below a cluster,
+				   int index,     // index counts clusters of the level left to right
+				   bool on);
 };
 
 
@@ -0,0 +1,147 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __SCRATCH_ARENA_HH
+#define __SCRATCH_ARENA_HH
+
+// Scratch memory for the temporaries of a task (Job::scratch). A task's
+// arena is a stack of chunks that only grows; the whole arena is released
+// when the task's last strand joins. Chunks come from the pool of the
+// cluster the task is anchored at and go back to it, so they have been
+// first touched by that cluster's threads, on its NUMA node.
+
+#include "Thread.hh"
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SCRATCH_CHUNK_SIZE  (1<<16)               // Smallest chunk, larger requests get their own
+#define SCRATCH_ALIGN       64
+
+class ScratchPool {
+public:
+  struct Chunk {
+    Chunk *           _next;
+    size_t            _capacity;                  // Usable bytes after the header
+    char *            data () {return (char*)this + SCRATCH_ALIGN;}
+  };
+
+private:
+  Chunk *             _free;                      // Searched first fit
+  Mutex               _mutex;
+
+public:
+  ScratchPool () : _free (NULL) {}
+  ~ScratchPool () {
+    while (_free != NULL) {
+      Chunk * next = _free->_next;
+      free (_free);
+      _free = next;
+    }
+  }
+
+  // A chunk of at least bytes, recycled if one is free, else allocated and
+  // first touched by the calling thread
+  Chunk * get (size_t bytes) {
+    _mutex.lock ();
+    for (Chunk ** c=&_free; *c!=NULL; c=&(*c)->_next) {
+      if ((*c)->_capacity >= bytes) {
+	Chunk * chunk = *c;
+	*c = chunk->_next;
+	_mutex.unlock ();
+	return chunk;
+      }
+    }
+    _mutex.unlock ();
+
+    size_t capacity = bytes < SCRATCH_CHUNK_SIZE ? SCRATCH_CHUNK_SIZE : bytes;
+    Chunk * chunk;
+    if (posix_memalign ((void**)&chunk, SCRATCH_ALIGN, SCRATCH_ALIGN+capacity) != 0)
+      return NULL;
+    chunk->_capacity = capacity;
+    long page_size = sysconf (_SC_PAGESIZE);
+    for (size_t off=0; off<capacity; off+=page_size)
+      chunk->data()[off] = 0;
+    return chunk;
+  }
+
+  // Return a list of chunks linked through _next
+  void put (Chunk * chunks) {
+    if (chunks == NULL)
+      return;
+    Chunk * last = chunks;
+    while (last->_next != NULL)
+      last = last->_next;
+    _mutex.lock ();
+    last->_next = _free;
+    _free = chunks;
+    _mutex.unlock ();
+  }
+};
+
+// The strands of a task run one after the other, so an arena is never
+// used by two threads at once and needs no lock.
+class ScratchArena {
+public:
+  ScratchPool *       _pool;
+  void *              _cluster;                   // Set and used by the scheduler, see Scheduler::open_scratch
+  ScratchPool::Chunk *_chunks;                    // Current chunk first
+  size_t              _top;                       // Bytes used in the current chunk
+  size_t              _charged;                   // Bytes handed out, rounded to SCRATCH_ALIGN
+  size_t              _reserved;                  // Of those, covered by the task's size, set by the scheduler
+
+  ScratchArena ()
+    : _pool (NULL), _cluster (NULL), _chunks (NULL), _top (0), _charged (0), _reserved (0) {}
+
+  // Bytes beyond the task's own reservation, the only ones charged again
+  size_t unreserved () {return _charged > _reserved ? _charged-_reserved : 0;}
+
+  void * alloc (size_t bytes) {
+    bytes = (bytes+SCRATCH_ALIGN-1) & ~(size_t)(SCRATCH_ALIGN-1);
+    if (_chunks == NULL || _top+bytes > _chunks->_capacity) {
+      ScratchPool::Chunk * chunk = _pool->get (bytes);
+      if (chunk == NULL)
+	return NULL;
+      chunk->_next = _chunks;
+      _chunks = chunk;
+      _top = 0;
+    }
+    void * p = _chunks->data()+_top;
+    _top += bytes;
+    _charged += bytes;
+    return p;
+  }
+
+  // Give every chunk back
+  void release () {
+    _pool->put (_chunks);
+    _chunks = NULL;
+    _top = 0;
+    _charged = 0;
+  }
+};
+
+#endif
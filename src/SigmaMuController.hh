@@ -0,0 +1,181 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __SIGMAMUCONTROLLER_HH
+#define __SIGMAMUCONTROLLER_HH
+
+// Online tuning of the per-level SIGMA and MU of a space-bounded scheduler.
+//
+// Threads count, per level, how many jobs they tried to fit and how many
+// were rejected, and how many of their get calls came back empty (the
+// NO_JOB state). Cache misses per level can be fed in from outside, e.g.
+// from PCM samples. When some thread has made ADAPT_INTERVAL gets since
+// the last window, it looks at the window (any active thread may, so that
+// deactivating one does not stop the tuning):
+//
+//   - many empty gets and many rejects at a level: space bounds are
+//     starving threads, so SIGMA and MU of that level are lowered
+//     (tasks anchor higher, clusters admit more strands: load balance);
+//   - few empty gets and misses at a level growing: SIGMA and MU of that
+//     level are raised (tasks anchor lower, fewer strands share a cache:
+//     locality).
+//
+// Each step scales the parameter by ADAPT_STEP and keeps it in bounds.
+
+#include <iostream>
+#include <stdlib.h>
+#include "Locks.hh"
+
+#define ADAPT_INTERVAL     (1<<14)                // gets of the busiest thread between adjustments
+#define ADAPT_STEP         (1.1)
+#define ADAPT_IDLE_HIGH    (0.5)                  // fraction of empty gets
+#define ADAPT_IDLE_LOW     (0.1)
+#define ADAPT_REJECT_HIGH  (0.3)                  // fraction of rejected fits
+#define ADAPT_MISS_GROWTH  (1.1)                  // misses up by 10% over the last window
+
+#define SIGMA_MIN (0.1)
+#define SIGMA_MAX (0.9)
+#define MU_MIN    (0.05)
+#define MU_MAX    (0.5)
+
+class SigmaMuController {
+  // Per thread counters, each thread on its own cache lines
+  struct ThreadCounts {
+    unsigned long long   _gets;
+    unsigned long long   _empty_gets;
+    unsigned long long * _fits;                   // One per level
+    unsigned long long * _rejects;
+  } __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+  int                    _num_threads;
+  int                    _num_levels;             // Including the root and the leaves
+  ThreadCounts         * _counts;
+  volatile unsigned long long * _misses;          // Per level, fed by record_cache_misses
+  unsigned long long   * _last_misses;
+  int                    _num_adjustments;
+  volatile int           _adapting;               // Taken by the thread running adapt
+
+public:
+  SigmaMuController (int num_threads, int num_levels)
+    : _num_threads (num_threads), _num_levels (num_levels), _num_adjustments (0), _adapting (0) {
+    _counts = (ThreadCounts*) aligned_alloc (CACHE_LINE_SIZE, num_threads*sizeof(ThreadCounts));
+    int padded = CACHE_LINE_SIZE/sizeof(unsigned long long);
+    padded *= (num_levels+padded-1)/padded;
+    for (int t=0; t<num_threads; ++t) {
+      _counts[t]._gets = _counts[t]._empty_gets = 0;
+      _counts[t]._fits = new unsigned long long[padded];
+      _counts[t]._rejects = new unsigned long long[padded];
+      for (int l=0; l<num_levels; ++l)
+	_counts[t]._fits[l] = _counts[t]._rejects[l] = 0;
+    }
+    _misses = new unsigned long long[num_levels];
+    _last_misses = new unsigned long long[num_levels];
+    for (int l=0; l<num_levels; ++l)
+      _misses[l] = _last_misses[l] = 0;
+  }
+
+  ~SigmaMuController () {
+    for (int t=0; t<_num_threads; ++t) {
+      delete [] _counts[t]._fits;
+      delete [] _counts[t]._rejects;
+    }
+    free (_counts);
+    delete [] _misses;
+    delete [] _last_misses;
+  }
+
+  void count_get (int thread_id, bool empty) {
+    ++_counts[thread_id]._gets;
+    if (empty) ++_counts[thread_id]._empty_gets;
+  }
+
+  void count_fit (int thread_id, int level, bool rejected) {
+    ++_counts[thread_id]._fits[level];
+    if (rejected) ++_counts[thread_id]._rejects[level];
+  }
+
+  void record_cache_misses (int level, unsigned long long misses) {
+    __sync_fetch_and_add (&_misses[level], misses);
+  }
+
+  // True when thread_id should call adapt now; adapt resets every count,
+  // so the first thread to reach ADAPT_INTERVAL closes the window
+  bool due (int thread_id) {
+    return (_counts[thread_id]._gets % ADAPT_INTERVAL) == 0
+      && __sync_bool_compare_and_swap (&_adapting, 0, 1);
+  }
+
+  // Adjust sigmas/mus (indexed by level) from the window since the last call.
+  // Counters are read without synchronization; they are only a signal.
+  // Only call it after due returned true.
+  void adapt (volatile double * sigmas, volatile double * mus) {
+    unsigned long long gets=0, empty_gets=0;
+    for (int t=0; t<_num_threads; ++t) {
+      gets += _counts[t]._gets;            _counts[t]._gets = 0;
+      empty_gets += _counts[t]._empty_gets; _counts[t]._empty_gets = 0;
+    }
+    double idle = gets>0 ? (double)empty_gets/gets : 0;
+
+    for (int l=1; l<_num_levels-1; ++l) {  // Neither the root nor the leaves
+      unsigned long long fits=0, rejects=0;
+      for (int t=0; t<_num_threads; ++t) {
+	fits += _counts[t]._fits[l];       _counts[t]._fits[l] = 0;
+	rejects += _counts[t]._rejects[l]; _counts[t]._rejects[l] = 0;
+      }
+      double reject_rate = fits>0 ? (double)rejects/fits : 0;
+      unsigned long long misses = _misses[l];
+      bool misses_grew = _last_misses[l]>0 && misses > ADAPT_MISS_GROWTH*_last_misses[l];
+      _last_misses[l] = misses;
+      _misses[l] = 0;
+
+      if (idle > ADAPT_IDLE_HIGH && reject_rate > ADAPT_REJECT_HIGH) {
+	sigmas[l] = clamp (sigmas[l]/ADAPT_STEP, SIGMA_MIN, SIGMA_MAX);
+	mus[l] = clamp (mus[l]/ADAPT_STEP, MU_MIN, MU_MAX);
+	++_num_adjustments;
+      } else if (idle < ADAPT_IDLE_LOW && misses_grew) {
+	sigmas[l] = clamp (sigmas[l]*ADAPT_STEP, SIGMA_MIN, SIGMA_MAX);
+	mus[l] = clamp (mus[l]*ADAPT_STEP, MU_MIN, MU_MAX);
+	++_num_adjustments;
+      }
+    }
+    _adapting = 0;
+  }
+
+  void print (volatile double * sigmas, volatile double * mus) {
+    std::cout<<"Adaptive SIGMA/MU, "<<_num_adjustments<<" adjustments:";
+    for (int l=1; l<_num_levels-1; ++l)
+      std::cout<<" L"<<l<<" ("<<sigmas[l]<<", "<<mus[l]<<")";
+    std::cout<<std::endl;
+  }
+
+private:
+  static double clamp (double v, double lo, double hi) {
+    return v<lo ? lo : (v>hi ? hi : v);
+  }
+};
+
+#endif
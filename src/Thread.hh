@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <sched.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <iostream>
 
 #define MY_SIGNAL 1
@@ -149,6 +151,12 @@ public:
     lock();
     return;
   }
+
+  void timed_wait (long usec) {        // Spurious wakeups are allowed, waiters recheck
+    unlock();
+    usleep(usec);
+    lock();
+  }
     
   void signal    () {
     if (start == end) {
@@ -228,6 +236,14 @@ public:
   
   // condition variable related methods
   void wait      () { pthread_cond_wait( & _cond, & _mutex ); }
+  void timed_wait( long usec ) {       // wait, or give up after usec
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, & ts );
+    ts.tv_sec  += usec / 1000000;
+    ts.tv_nsec += (usec % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+    pthread_cond_timedwait( & _cond, & _mutex, & ts );
+  }
   void signal    () { pthread_cond_signal( & _cond ); }
   void broadcast () { pthread_cond_broadcast( & _cond ); }
 };
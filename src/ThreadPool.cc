@@ -15,8 +15,6 @@
 #include <sstream>
 #include <assert.h>
 
-#define LOG 1
-
 #if LOG == 1
 static std::ostringstream log_stream;
 ThreadTimer *active;
@@ -208,7 +206,7 @@ PoolThr::run_job() {
     exit (-1);
   }
     
-  _job->set_thread (this);
+  current_thread = this;
   _job->run();                                 // execute job
   
   _job->unlock();
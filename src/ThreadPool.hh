@@ -42,9 +42,7 @@
 #include "Scheduler.hh"
 #include "WSScheduler.hh"
 #include "HR1Scheduler.hh"
-#include "HR2Scheduler.hh"
-#include "HR3Scheduler.hh"
-#include "HR4Scheduler.hh"
+#include "HRTScheduler.hh"
 
 #include "gettime.hh"
 //#include "libperf.h"
@@ -54,6 +52,22 @@
 
 class ThreadPool;
 
+// Runtime switches. tp_options starts from the defaults in knobs.hh, which
+// the environment overrides (TP_LOG, TP_COUNTERS, TP_STRAND_SIZE_MODE), and
+// is replaced by the options passed to tp_init, if any. It is only written
+// before the threads start, so disabled instrumentation costs a predicted
+// branch on a line that stays in every cache.
+struct TPOptions {
+  bool               _log;             // Time get/add/done per thread, print at tp_sync_all/tp_done
+  bool               _counters;        // Also read the PCM counters around the run, needs _log
+  int                _strand_size_mode;// 1: a strand is charged the size of its task
+  TPOptions ();
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+extern TPOptions tp_options;           // Defined in DecentralThreadPool.cc
+
+#define TP_LOGGING __builtin_expect (tp_options._log, 0)
+
 // Thread handled by threadpool
 class PoolThr : public Thread {
   friend class ThreadPool;
@@ -61,24 +75,47 @@ protected:
   ThreadPool       * _pool;           // pool we are in
   
   Job              * _job;            // job to run and data for it
+  Job              * _reused;         // _job forked with itself as the continuation
+  CancelScope      * _open_scope;     // For the children of the next fork, see Job::open_scope
 
+  bool               _hungry;         // Counted in the pool's _num_hungry
+  int                _help_depth;     // Nested calls of help
   bool               _done;           // Thread has come out of infinite loop
   bool               _end;            // indicates end-of-thread
   Mutex              _del_mutex;      // mutex for preventing premature deletion
+  ull_t              _split_start;    // Start of the interval being timed (_log)
     
 public:
+  enum { SPLIT_ACTIVE=0, SPLIT_NO_JOB, SPLIT_GET, SPLIT_ADD, SPLIT_DONE };
+
   PoolThr ( const int n, ThreadPool * p )
     : Thread(n), _pool(p),
-      _job(NULL), _end(false),
+      _job(NULL), _reused(NULL), _open_scope(NULL), _hungry(false), _help_depth(0), _end(false),
       _done(false)
     {}
   ~PoolThr () {}//;
 
   ThreadPool*  get_pool ();
   virtual void inf_loop ();            // parallel running method
+  template <class Sched>
+  void         loop     (Sched* sched);// Get jobs from sched and run them till the root joins
   void         run_job  ();            // Run the job, unlock, and delete if needed
   void         add_job  (Job* job);    // Add job to threadpool's scheduler' taskQ
+  void         reuse_job(Job* job) {_reused = job;} // job is its own continuation, run_job must not touch it again
+  bool         reused   (Job* job) {return _reused == job;}
+  void         open_scope(CancelScope* scope) {_open_scope = scope;}
+  CancelScope* take_scope() {CancelScope* s = _open_scope; _open_scope = NULL; return s;}
   void         quit     ();            // quit thread (reset data and wake up)
+  void         help     (Job* job);    // Run other jobs until job has executed, see ThreadPool::sync
+
+protected:
+  void         enter_loop ();          // Register thread with the pool
+  void         exit_loop  ();          // Mark thread idle, wake up sync_all
+  void         set_hungry (bool on);   // Whether get found no job, only counts changes
+  void         split_time (int split) {// Charge time since last split to 'split' (_log)
+                 if (TP_LOGGING) log_split (split); }
+  void         log_split  (int split);
+  void         log_wait   (Job* job);  // Charge the time job was queued to its class (_log)
 };
 
 // takes jobs and executes them in threads
@@ -92,17 +129,22 @@ protected:
 public:
   uint              _idle_count;       // number of idle threads
   bool              _null_join;        // Has a fork with null continuation been called?
+  volatile int      _num_roots;        // Root jobs started by tp_run and not yet joined
+  volatile int      _num_hungry;       // Active workers whose last get found no job
   Condition         _idle_cond;        // condition for synchronisation of idle list
 
   Scheduler *       _scheduler;        // Task order handler
   Condition         _scheduler_cond;   // Mutex/Cond to access job queue
   Condition         _inf_loop_cond;    // Signal to start inf  loop in decentral threadpool
+  Condition         _park_cond;        // Deactivated threads wait here, see tp_set_active
+  Condition         _sync_cond;        // Threads outside the pool wait here in sync
   Mutex             _print_lock;
 public:
   ThreadPool ( const uint max_p,
 	       Scheduler * sched = NULL,
-	       uint * proc_ids=NULL);  // Set the threads's affinity to proc_ids
-  ~ThreadPool ();
+	       uint * proc_ids=NULL,   // Set the threads's affinity to proc_ids
+	       bool spawn=true);       // false: derived class calls create_threads
+  virtual ~ThreadPool ();
   int   set_thread_affinity (
                       uint thread_id,  // Set the affinity of thread_id to proc_id
 		      uint proc_id);   // Return -1 on fail, 0 if not
@@ -119,15 +161,113 @@ public:
   void  done_job ( Job * job,          // Done with this job.
 		   PoolThr* thr,       // If its a cont_job, last job 'join'ing was @thr
 		   bool deactivate);   // false, if this is called after 'fork', true if after 'join'
-  void  sync     ( Job * job );        // Wait till job is done    
+  void  sync     ( Job * job );        // Wait till job is done, a worker runs other jobs meanwhile
+  void  completed ( Job * job ) {      // A kept job and its continuations are done, wake its syncs
+        _sync_cond.lock();
+        job->_executed = true;         // The syncing thread may free it from here on
+        _sync_cond.broadcast();
+        _sync_cond.unlock();}
+  void  wait_completed ( Job * job,    // Wait for completed (job), for at most usec
+			 long usec ) {
+        _sync_cond.lock();
+        if (!job->executed())
+	  _sync_cond.timed_wait (usec);
+        _sync_cond.unlock();}
   void  sync_all ();                   // Wait till all threads return
   void  change_idle_count (int diff);  // change _idle_cont atomically
   bool  null_joined () {               // Check on status of null join
         return _null_join; }
   void  set_null_join () {
         _null_join = false;}
-  void  reset_null_join () {
-        _null_join = true;}  
+  void  reset_null_join () {          // A root job joined, stop once no root is left
+        int n;
+        do { n = _num_roots; } while (n > 0 && !__sync_bool_compare_and_swap (&_num_roots, n, n-1));
+        if (n <= 1) {
+	  _null_join = true;
+	  unpark ();
+	}}
+  void  add_root () {
+        __sync_fetch_and_add (&_num_roots, 1);}
+  void  park   ( PoolThr * thr );      // Wait until thr is reactivated or the pool ends
+  void  unpark ();                     // Wake parked threads to recheck
+
+protected:
+  void  create_threads ( uint * proc_ids );
+  virtual
+  PoolThr* new_thread ( uint thread_no );
+  virtual                              // The scheduler calls of add_jobs and done_job
+  void  sched_add  ( int num_jobs, Job ** jobs, int thread_id ) {
+        _scheduler->add_multiple (num_jobs, jobs, thread_id);}
+  virtual
+  void  sched_done ( Job * job, int thread_id, bool deactivate ) {
+        _scheduler->done (job, thread_id, deactivate);}
+};
+
+inline void
+PoolThr::set_hungry (bool on) {
+  if (_hungry != on) {
+    _hungry = on;
+    __sync_fetch_and_add (&_pool->_num_hungry, on ? 1 : -1);
+  }
+}
+
+template <class Sched>
+void
+PoolThr::loop (Sched * sched) {
+  int empty_gets = 0;
+  enter_loop ();
+  while ( !_pool->null_joined() ) {
+    split_time (SPLIT_NO_JOB);
+    if ( (_job=sched->get(_thread_no)) != NULL) {
+      empty_gets = 0;
+      set_hungry (false);
+      split_time (SPLIT_GET);
+      run_job ();
+      split_time (SPLIT_ACTIVE);
+    } else if (!sched->active(_thread_no)) {
+      set_hungry (false);                      // Parked, it will not take work
+      if (++empty_gets < PARK_EMPTY_GETS)      // get steals from a random queue, one
+	continue;                              // empty probe does not mean all are empty
+      empty_gets = 0;
+      _pool->park (this);
+    } else {
+      set_hungry (true);
+    }
+  }
+  set_hungry (false);
+  exit_loop ();
+}
+
+// Pool thread that knows the concrete scheduler type, so that the
+// scheduler's (final) get is called directly and can be inlined. The
+// pool does the same for add and done: the pool's call is then the only
+// indirect one, the scheduler's is inlined in it.
+template <class Sched>
+class StaticPoolThr : public PoolThr {
+  Sched            * _sched;
+public:
+  StaticPoolThr ( const int n, ThreadPool * p, Sched * sched )
+    : PoolThr (n, p), _sched (sched) {}
+  void inf_loop () { loop (_sched); }
+};
+
+template <class Sched>
+class StaticThreadPool : public ThreadPool {
+public:
+  StaticThreadPool ( const uint max_p, Sched * sched, uint * proc_ids=NULL )
+    : ThreadPool (max_p, sched, proc_ids, false) {
+    create_threads (proc_ids);
+  }
+protected:
+  PoolThr* new_thread ( uint thread_no ) {
+    return new StaticPoolThr<Sched> (thread_no, this, static_cast<Sched*>(_scheduler));
+  }
+  void  sched_add  ( int num_jobs, Job ** jobs, int thread_id ) {
+    static_cast<Sched*>(_scheduler)->add_multiple (num_jobs, jobs, thread_id);
+  }
+  void  sched_done ( Job * job, int thread_id, bool deactivate ) {
+    static_cast<Sched*>(_scheduler)->done (job, thread_id, deactivate);
+  }
 };
 
 // To access the global thread-pool
@@ -138,10 +278,29 @@ void print_timers (uint num_procs);
 void tp_init ( const uint p,
 	       uint * proc_ids = NULL, // Thread-processor affinities
 	       Scheduler * sched=NULL, // init global thread_pool
-	       Job * root = NULL);     // If job is specified, tp_run is implicitly called here
+	       Job * root = NULL,      // If job is specified, tp_run is implicitly called here
+	       const TPOptions * options = NULL); // Replace tp_options, NULL keeps them
+void tp_init_pool ( ThreadPool * pool, // Make an already created pool the global pool,
+		    Job * root = NULL);// start_timers must be called before creating it
+template <class Sched>
+void tp_init_static ( const uint p,     // tp_init for a scheduler type known at compile time
+		      uint * proc_ids,
+		      Sched * sched,
+		      Job * root = NULL,
+		      const TPOptions * options = NULL) {
+  if (options != NULL)
+    tp_options = *options;
+  start_timers (p);
+  tp_init_pool (new StaticThreadPool<Sched> (p, sched, proc_ids), root);
+}
 void tp_run  ( Job * job );            // run job
 void tp_sync ( Job * job );            // synchronise with specific job
 void tp_sync_all ();                   // synchronise with all jobs
 void tp_done ();                       // finish thread pool, implicitly syncs--waits for all jobs to be done and all threads to become idle
+void tp_set_active ( uint thread_id,   // Deactivate (drain, then park) or reactivate a worker
+		     bool on );
+void tp_set_cluster_active ( int level,// Same for every worker below a cluster
+			     int index,
+			     bool on );
 
 #endif  // __THREADPOOL_HH
@@ -29,35 +29,39 @@
 
 void
 WS_Scheduler::add (Job *job, int thread_id) {
-	check_range (thread_id, 0, _num_threads+1, new std::string (__func__));
-	if (thread_id != _num_threads) {
-		_local_lock[thread_id].lock();
-		_job_queues[thread_id].push_back(job);
-		_local_lock[thread_id].unlock();
-	} else {   // External actor is putting job in the system
-		_local_lock[0].lock();
-		_job_queues[0].push_back(job);
-		_local_lock[0].unlock();
-	}
+	add_multiple (1, &job, thread_id);
 }
 void
 WS_Scheduler::add_multiple (int num_jobs, Job **jobs, int thread_id) {
 	check_range (thread_id, 0, _num_threads+1, new std::string (__func__));
-	if (thread_id != _num_threads) {
-	  for (int i=0; i<num_jobs; ++i) {
+	if (thread_id == _num_threads)   // External actor is putting job in the system
+		thread_id = 0;
+	for (int i=0; i<num_jobs; ++i) {
 		_local_lock[thread_id].lock();
-		_job_queues[thread_id].push_back(jobs[i]);
+		queue(thread_id, jobs[i]->priority()).push_back(jobs[i]);
 		_local_lock[thread_id].unlock();
-	  }
-	} else {   // External actor is putting job in the system
-	  for (int i=0; i<num_jobs; ++i) {
-		_local_lock[0].lock();
-		_job_queues[0].push_back(jobs[i]);
-		_local_lock[0].unlock();
-	  }
 	}
 }
 
+// The highest priority lane of owner's queue with a job, unless a lower
+// one has been passed over PRIORITY_AGING times in the gets of thread_id
+int
+WS_Scheduler::lane (int owner, int thread_id) {
+	int * passed = _passed + thread_id*NUM_PRIORITIES;
+	int ret = -1;
+	for (int p=NUM_PRIORITIES-1; p>=0; --p) {
+		if (queue(owner, p).empty())
+			continue;
+		if (ret == -1) {
+			ret = p;
+		} else if (++passed[p] >= PRIORITY_AGING) {
+			passed[p] = 0;
+			ret = p;
+		}
+	}
+	return ret;
+}
+
 int 
 WS_Scheduler::steal_choice (int thread_id) {
   return  (int) ((((double)rand())/((double)RAND_MAX))*_num_threads);
@@ -71,22 +75,26 @@ WS_Scheduler::get (int thread_id) {
 	check_range (thread_id, 0, _num_threads, new std::string (__func__));
 	
 	_local_lock[thread_id].lock();
-	if (_job_queues[thread_id].size() > 0) {
-		Job * ret = _job_queues[thread_id].back();
-		_job_queues[thread_id].pop_back();
+	int l = lane (thread_id, thread_id);
+	if (l >= 0) {
+		Job * ret = queue(thread_id, l).back();
+		queue(thread_id, l).pop_back();
 		_local_lock[thread_id].unlock();
 		return ret;
 	} else {
 		//std::cerr<<++steals<<std::endl;
 		_local_lock[thread_id].unlock();
+		if (!active (thread_id))    // Drained, others may still steal from us
+			return NULL;
 		for (int i=0; i<1; ++i) {
 			
 		        int choice = steal_choice(thread_id);
 			_steal_lock[choice].lock();
 			_local_lock[choice].lock();
-			if (_job_queues[choice].size() > 0) {
-				Job * ret = _job_queues[choice].front();
-				_job_queues[choice].erase(_job_queues[choice].begin());
+			int l = lane (choice, thread_id);
+			if (l >= 0) {
+				Job * ret = queue(choice, l).front();
+				queue(choice, l).erase(queue(choice, l).begin());
 				++_num_steals[thread_id];
 				_local_lock[choice].unlock();
 				_steal_lock[choice].unlock();
@@ -114,16 +122,25 @@ WS_Scheduler::done (Job *job, int thread_id,
 }
 
 WS_Scheduler::~WS_Scheduler () {
-  delete _job_queues;
+  delete [] _job_queues;
+  delete [] _passed;
 }
 
 void
 WS_Scheduler::print_scheduler_stats () {
-  lluint total_steals;
-  for (int i=0; i<_num_threads; ++i)
+  lluint total_steals=0;
+  LockStats local_stats, steal_stats;
+  for (int i=0; i<_num_threads; ++i) {
     total_steals += _num_steals[i];
+    local_stats.add (lock_stats (_local_lock[i]));
+    steal_stats.add (lock_stats (_steal_lock[i]));
+  }
 
-  std::cout<<"Total number of steals"<<std::endl;
+  std::cout<<"Total number of steals: "<<total_steals<<std::endl;
+  if (local_stats._acquires > 0)
+    local_stats.print ("Local locks");
+  if (steal_stats._acquires > 0)
+    steal_stats.print ("Steal locks");
 }
 
 int 
@@ -156,22 +173,26 @@ PWS_Scheduler::get (int thread_id) {
 	check_range (thread_id, 0, _num_threads, new std::string (__func__));
 	
 	_local_lock[thread_id].lock();
-	if (_job_queues[thread_id].size() > 0) {
-		Job * ret = _job_queues[thread_id].back();
-		_job_queues[thread_id].pop_back();
+	int l = lane (thread_id, thread_id);
+	if (l >= 0) {
+		Job * ret = queue(thread_id, l).back();
+		queue(thread_id, l).pop_back();
 		_local_lock[thread_id].unlock();
 		return ret;
 	} else {
 		//std::cerr<<++steals<<std::endl;
 		_local_lock[thread_id].unlock();
+		if (!active (thread_id))    // Drained, others may still steal from us
+			return NULL;
 		for (int i=0; i<1; ++i) {
 			
 		        int choice = steal_choice(thread_id);
 			_steal_lock[choice].lock();
 			_local_lock[choice].lock();
-			if (_job_queues[choice].size() > 0) {
-				Job * ret = _job_queues[choice].front();
-				_job_queues[choice].erase(_job_queues[choice].begin());
+			int l = lane (choice, thread_id);
+			if (l >= 0) {
+				Job * ret = queue(choice, l).front();
+				queue(choice, l).erase(queue(choice, l).begin());
 				++_num_steals[thread_id];
 				_local_lock[choice].unlock();
 				_steal_lock[choice].unlock();
@@ -28,25 +28,35 @@
 #define __WSSCHEDULER_HH
 
 #include "Scheduler.hh"
+#include "Locks.hh"
+#include "knobs.hh"
 
 class WS_Scheduler : public Scheduler {
 protected:
   int                 _num_jobs;                  // Total number of jobs
   lluint            * _num_steals;                // Number of steals, one counter for each job
-  std::vector<Job*> * _job_queues;                // One queue per processor
-  Mutex             * _local_lock;                // Local processor locks this before grabbing a locally queued job
-  Mutex             * _steal_lock;                // Stealing procs grab this lock before locking the local lock
+  std::vector<Job*> * _job_queues;                // One queue per processor and priority class
+  int               * _passed;                    // Per processor and class, see lane
+  WS_LOCAL_LOCK     * _local_lock;                // Local processor locks this before grabbing a locally queued job
+  WS_STEAL_LOCK     * _steal_lock;                // Stealing procs grab this lock before locking the local lock
 public:
   WS_Scheduler (int num_threads)
     : Scheduler (num_threads),
       _num_jobs (0) {
-    _job_queues = new std::vector<Job*>[_num_threads];
-    _local_lock = new Mutex[num_threads];
-    _steal_lock = new Mutex[num_threads];
+    _job_queues = new std::vector<Job*>[_num_threads*NUM_PRIORITIES];
+    _passed = new int[_num_threads*NUM_PRIORITIES];
+    for (int i=0; i<_num_threads*NUM_PRIORITIES; ++i)
+      _passed[i] = 0;
+    _local_lock = new WS_LOCAL_LOCK[num_threads];
+    _steal_lock = new WS_STEAL_LOCK[num_threads];
     _num_steals = new lluint[num_threads];
+    for (int i=0; i<num_threads; ++i)
+      _num_steals[i] = 0;
   }
   ~WS_Scheduler();
   int steal_choice (int thread_id);               // Which queue to steal from, when you run out of work
+  std::vector<Job*> & queue (int owner, int lane) {return _job_queues[owner*NUM_PRIORITIES+lane];}
+  int lane (int owner, int thread_id);            // Lane of owner's queue thread_id takes from, owner locked
   
   void add  (Job *job, int thread_id );           // Add a job to the task queue, -1 thread_id for anon enqueues
   void add_multiple  (int num_jobs,Job **jobs, int thread_id );
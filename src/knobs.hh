@@ -27,9 +27,32 @@
 #ifndef SCHED_KNOBS 
 #define SCHED_KNOBS
 
-#define LOG 1
+// Defaults of the runtime options (tp_options, see ThreadPool.hh), each
+// can be overridden from the environment without rebuilding
+#define LOG 0                                     // TP_LOG=1: time the scheduler calls
+#define COUNTERS_ENABLED 0                        // TP_COUNTERS=1: read the PCM counters (with TP_LOG), needs PCM support
+#ifndef STRAND_SIZE_MODE
+#define STRAND_SIZE_MODE 1                        // TP_STRAND_SIZE_MODE: 1 to charge strands their task size
+#endif
+
+#define LEAK_CHECK 0                              // Count live Jobs and Forks, reported by tp_done
+
+#define SIZE_PROFILE_SLOTS 2                      // Distinct block sizes whose job sizes are memoized
+#define MAX_CACHE_LEVELS 6                        // Levels of the HRT tree of caches, below the root
+
+// Locks of the WS deques: Mutex, TTASLock, TicketLock, MCSLock or CLHLock.
+// They change the layout of WS_Scheduler, so set them here and rebuild the
+// library, not with -D on one program.
+#define WS_LOCAL_LOCK Mutex                       // Taken by the owner to pop a job
+#define WS_STEAL_LOCK Mutex                       // Taken by thieves before the local lock
+
+#define NUM_PRIORITIES 3                          // Priority classes of root jobs, 0 is the lowest
+#define PRIORITY_AGING 16                         // Gets a queued lower class may be passed over
 
-#define COUNTERS_ENABLED 1
+#define PARK_EMPTY_GETS 64                        // Empty gets in a row before a deactivated thread parks
+#define HELP_DEPTH 32                             // Nested tp_syncs a worker runs other jobs in, see PoolThr::help
+#define HELP_EMPTY_GETS 64                        // Empty gets in a row before a syncing worker sleeps
+#define HELP_WAIT_USEC 100                        // How long it sleeps before it looks for jobs again
 
 #define PRECISION_TICKS 1
 #define PRECISION_NANOSEC 2
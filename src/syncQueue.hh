@@ -26,6 +26,7 @@
 
 #include <queue>
 #include "Thread.hh"
+#include "knobs.hh"
 #include <assert.h>
 #include <cstdlib>
 
@@ -94,22 +95,79 @@ public:
   size_t size() const{return _queue.size();}
 };
 
+// A queue of jobs with a lane per priority class (Job::priority). Pops
+// serve the highest lane that has a job, except that a lower lane passed
+// over PRIORITY_AGING times while it had jobs is served next, so bulk work
+// still progresses under a steady stream of urgent work. The counts are
+// not exact when several threads pop at once.
+template <typename T>
+class LaneQueue {
+  synchronized_queue<T> _lanes[NUM_PRIORITIES];
+  int                   _passed[NUM_PRIORITIES];
+
+  bool take (int lane, T * ret, bool front) {
+    return front ? _lanes[lane].safepop_front (ret) : _lanes[lane].safepop_end (ret);
+  }
+
+  bool pop (T * ret, bool front) {
+    bool higher = false;
+    for (int p=NUM_PRIORITIES-1; p>=0; --p) {
+      if (_lanes[p].empty())
+	continue;
+      if (higher && ++_passed[p] >= PRIORITY_AGING) {
+	_passed[p] = 0;
+	if (take (p, ret, front))
+	  return true;
+      }
+      higher = true;
+    }
+    for (int p=NUM_PRIORITIES-1; p>=0; --p)
+      if (take (p, ret, front))
+	return true;
+    return false;
+  }
+
+public:
+  LaneQueue () {
+    for (int p=0; p<NUM_PRIORITIES; ++p)
+      _passed[p] = 0;
+  }
+
+  void push       (const T &item) {_lanes[item->priority()].push (item);}
+  void push_front (const T &item) {_lanes[item->priority()].push_front (item);}
+  bool safepop_front (T * ret) {return pop (ret, true);}
+  bool safepop_end   (T * ret) {return pop (ret, false);}
+
+  bool empty () const {
+    for (int p=0; p<NUM_PRIORITIES; ++p)
+      if (!_lanes[p].empty())
+	return false;
+    return true;
+  }
+  size_t size () const {
+    size_t n = 0;
+    for (int p=0; p<NUM_PRIORITIES; ++p)
+      n += _lanes[p].size();
+    return n;
+  }
+};
+
 template<typename T>
 class DistrQueue {
   int _max_q; 
-  synchronized_queue<T> *_queues;
+  LaneQueue<T> *_queues;
 public:
 #define DISTRQ_SPACER 2 // To prevent false sharing
   DistrQueue(int max_q) {
     _max_q = max_q;
-    _queues = new synchronized_queue<T>[_max_q*DISTRQ_SPACER];
+    _queues = new LaneQueue<T>[_max_q*DISTRQ_SPACER];
   }
 
   ~DistrQueue() {
-    delete _queues;
+    delete [] _queues;
   }
 
-  bool check_range (int child_id) {assert (child_id>=0 && child_id<_max_q);}
+  bool check_range (int child_id) {assert (child_id>=0 && child_id<_max_q); return true;}
  
   void reset () {
     for (int i=0; i<_max_q; ++i)
@@ -117,7 +175,7 @@ public:
   }
 
   int size (int child_id) {
-    _queues[child_id*DISTRQ_SPACER].size();
+    return _queues[child_id*DISTRQ_SPACER].size();
   }
   
   void add_to_distr_queue (T entry, int child_id) {
@@ -148,36 +206,53 @@ public:
   lluint                       _block_size;
   lluint                     * _thresholds; // In decreasing order, the size ceilings for each queue.
                                              // Number of entries = _num_levels
-  synchronized_queue<E>**      _queues;      // Classify jobs based on task size, normal queues for bottom buckets
+  LaneQueue<E>**               _queues;      // Classify jobs based on task size, normal queues for bottom buckets
   int                          _num_children;// For distributed queue
-  const double                 _sigma;
+  const volatile double      * _sigmas;      // One per threshold, owned by the scheduler and
+                                             // may be changed while jobs are queued
+  int                          _size_slot;   // Slot of _block_size in the jobs' size profiles, -1 if none
 
-  Buckets (int num_levels, lluint size, lluint block_size, lluint* thresholds, int num_children, double sigma)
+  Buckets (int num_levels, lluint size, lluint block_size, lluint* thresholds, int num_children,
+	   const volatile double* sigmas)
     : _num_levels (num_levels),
       _size (size),
       _block_size (block_size),
       _num_children (num_children),
-      _sigma(sigma)
+      _sigmas(sigmas),
+      _size_slot (-1)
   {
     _thresholds = new lluint [num_levels+1]; _thresholds[num_levels]=0;
-    _queues = new synchronized_queue<E>* [num_levels]; 
+    _queues = new LaneQueue<E>* [num_levels]; 
     for (int i=0; i<num_levels; ++i) {
-      _queues[i] = new synchronized_queue<E>;
+      _queues[i] = new LaneQueue<E>;
       _thresholds[i] = thresholds[i];
     }
     _thresholds[0]= 1L << 45;	
     if (_size==0) _size = 1L << 45;
   }
   
-  int add_job_to_bucket (E job, int child_id) { // return bucket level
-    lluint task_size = job->size(_block_size);
-    for (int i=0; i<_num_levels; ++i) {
-      if ((double)task_size > _sigma*(double)_thresholds[i+1]) {
-	_queues[i]->push_front (job);
+  void set_size_slot (int slot) {_size_slot = slot;}
+
+  lluint size_of (E job) {                   // Memoized by the scheduler when the job was added
+    return _size_slot >= 0 ? job->profiled_size (_size_slot) : job->size (_block_size);
+  }
+
+  int level_of (lluint task_size) {          // bucket a task of this size belongs to
+    for (int i=0; i<_num_levels; ++i)
+      if ((double)task_size > _sigmas[i+1]*(double)_thresholds[i+1])
 	return i;
-      }
-    }
-    assert(false);exit(-1);
+    assert(task_size == 0);                    // Empty tasks (an empty sort segment) go to the bottom
+    return _num_levels-1;
+  }
+
+  int bucket_of (E job) {                    // Continuations run as strands of the task pinned here
+    return job->is_cont_job() ? 0 : level_of (size_of (job));
+  }
+
+  int add_job_to_bucket (E job, int child_id) { // return bucket level
+    int level = bucket_of (job);
+    _queues[level]->push_front (job);
+    return level;
   }
   
   int get_job_from_bucket (E* ret, int min_level, int child_id) { // return bucket level
@@ -188,9 +263,10 @@ public:
   }
   
   void return_to_queue (E job, int level, int child_id) {
-    lluint task_size = job->size(_block_size);
-    assert ((_sigma*((double)_thresholds[level]))>=(double)task_size
-		&& (double)task_size>(_sigma*((double)_thresholds[level+1])));
+    if (bucket_of (job) != level) { // sigma changed since it was queued
+      add_job_to_bucket (job, child_id);
+      return;
+    }
     _queues[level]->push_front (job);
   }
 };
@@ -200,8 +276,9 @@ class TopDistrBuckets : public Buckets<E> {
 public:
   DistrQueue<E>         * _top_queue;  // Decenrtalized Queue for top bucket
   
-  TopDistrBuckets (int num_levels, lluint size, lluint block_size, lluint* thresholds, int num_children, double sigma)
-    :  Buckets<E> (num_levels,size,block_size,thresholds,num_children, sigma)  {
+  TopDistrBuckets (int num_levels, lluint size, lluint block_size, lluint* thresholds, int num_children,
+		   const volatile double* sigmas)
+    :  Buckets<E> (num_levels,size,block_size,thresholds,num_children, sigmas)  {
     //**** DistrQ for top bucket only to supply level directly below ***
     // **** Don't bother if only 1 or 0 child below ***
     // **** Incremental over H2 ***********
@@ -212,48 +289,37 @@ public:
   }
   
   int add_job_to_bucket (E job, int child_id) { // return bucket level
-    lluint task_size = job->size(this->_block_size);
-    ++this->_num_jobs;
+    int level = this->bucket_of (job);
     //***** Incremental over Bucket ********
-    if (this->_num_children > 1)
-      if ((double)task_size > this->_sigma*this->_thresholds[1]) {
-	_top_queue->add_to_distr_queue(job, child_id);
-	return 0;
-      }
-    
-    for (int i=0; i<this->_num_levels; ++i) {
-      if ((double)task_size > this->_sigma*this->_thresholds[i+1]) {
-	this->_queues[i]->push_front (job);
-	return i;
-      }
-    } 
-    assert(false);exit(-1);
+    if (this->_num_children > 1 && level == 0) {
+      _top_queue->add_to_distr_queue(job, child_id);
+      return 0;
+    }
+
+    this->_queues[level]->push_front (job);
+    return level;
   }
   
   int get_job_from_bucket (E* ret, int min_level, int child_id) { // return bucket level
     //**** incremental over Bucket *******
     if (this->_num_children>1)
       if (min_level++ ==0)
-	if (true == _top_queue->safeget_from_distr_queue(ret,child_id)) {
-	  --this->_num_jobs;
+	if (true == _top_queue->safeget_from_distr_queue(ret,child_id))
 	  return 0;
-	}
     
     for (int i=min_level; i<this->_num_levels; ++i) {
-      if (!this->_queues[i]->empty() && this->_queues[i]->safepop_front(ret) == true) {
-	--this->_num_jobs;
+      if (!this->_queues[i]->empty() && this->_queues[i]->safepop_front(ret) == true)
 	return i;
-      }
     }
     return -1;
   }
   
   void return_to_queue (E job, int level, int child_id) {
-    lluint task_size = job->size(this->_block_size);
-    assert ((this->_sigma*(this->_thresholds[level]))>=(double)task_size
-	    && (double)task_size>(this->_sigma*(this->_thresholds[level+1])));
-    
-    ++this->_num_jobs;
+    if (this->bucket_of (job) != level) {
+      add_job_to_bucket (job, child_id);
+      return;
+    }
+
     //**** incremental over Bucket ********
     if (this->_num_children>1 && level==0)
       _top_queue->add_to_distr_queue(job, child_id);
@@ -261,3 +327,55 @@ public:
       this->_queues[level]->push_front (job);
   }  
 };
+
+// Buckets with a distributed queue at every level (layout used by HR4).
+// Falls back to plain queues when there is only one child to serve.
+template<class E>
+class DistrBuckets : public Buckets<E> {
+public:
+  DistrQueue<E>        ** _distr_queues;
+
+  DistrBuckets (int num_levels, lluint size, lluint block_size, lluint* thresholds, int num_children,
+		const volatile double* sigmas)
+    :  Buckets<E> (num_levels,size,block_size,thresholds,num_children, sigmas)  {
+    _distr_queues = NULL;
+    if (num_children > 1) {
+      _distr_queues = new DistrQueue<E>* [num_levels];
+      for (int i=0; i<num_levels; ++i)
+	_distr_queues[i] = new DistrQueue<E> (num_children);
+    }
+  }
+
+  int add_job_to_bucket (E job, int child_id) { // return bucket level
+    int level = this->bucket_of (job);
+    if (_distr_queues != NULL)
+      _distr_queues[level]->add_to_distr_queue(job, child_id);
+    else
+      this->_queues[level]->push_front (job);
+    return level;
+  }
+
+  int get_job_from_bucket (E* ret, int min_level, int child_id) { // return bucket level
+    for (int i=min_level; i<this->_num_levels; ++i) {
+      if (_distr_queues != NULL) {
+	if (true == _distr_queues[i]->safeget_from_distr_queue(ret,child_id))
+	  return i;
+      } else {
+	if (true == this->_queues[i]->safepop_front(ret))
+	  return i;
+      }
+    }
+    return -1;
+  }
+
+  void return_to_queue (E job, int level, int child_id) {
+    if (this->bucket_of (job) != level) {
+      add_job_to_bucket (job, child_id);
+      return;
+    }
+    if (_distr_queues != NULL)
+      _distr_queues[level]->add_to_distr_queue(job, child_id);
+    else
+      this->_queues[level]->push_front (job);
+  }
+};
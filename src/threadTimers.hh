@@ -24,6 +24,7 @@ public:
   ~ThreadTimer () {delete timers;}
 
   void inline add (uint proc_id, int timer_id, long long int time) {if(active) timers[loc(proc_id,timer_id)] += time;}
+  void inline max (uint proc_id, int timer_id, long long int time) {if(active && time > timers[loc(proc_id,timer_id)]) timers[loc(proc_id,timer_id)] = time;}
   void inline subtract (uint proc_id, int timer_id, long int val) {/*if(active) */timers[loc(proc_id,timer_id)] -= val;}
   inline long long int operator() (uint proc_id, int timer_id)     {return timers[loc(proc_id,timer_id)];}
   inline long long int get (uint proc_id, int timer_id)     {return timers[loc(proc_id,timer_id)];}  
@@ -44,7 +44,7 @@ public:
   }
 
   lluint strand_size(const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       return STRAND_SIZE;
@@ -90,7 +90,7 @@ public:
   }
   
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       return STRAND_SIZE;
@@ -130,7 +130,7 @@ public:
       + round_up(n*sizeof(int), block_size);
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       return STRAND_SIZE;
@@ -51,7 +51,7 @@ public:
   }
   
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       return STRAND_SIZE;
@@ -88,7 +88,7 @@ public:
 
   lluint size (const int block_size) {return 2*round_up(n*sizeof(E), block_size);}
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       return STRAND_SIZE;
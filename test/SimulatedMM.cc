@@ -67,7 +67,7 @@ public:
   }
 
   lluint strand_size (int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       
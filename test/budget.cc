@@ -0,0 +1,129 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "common.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Several roots under a root budget that admits one of them at a time. A
+// launcher starts them all from a worker and syncs on each, so the others
+// wait in the admission queue. Checks that some roots were deferred and
+// that every one of them ran. With 's' the launcher is a root of its own
+// size, too large for any other root to fit beside it: it must hand its
+// reservation back while it syncs.
+//   Usage: budget <2/3/4> <n> <roots> [s]
+
+#define USAGE "Usage: budget <2/3/4> <n> <roots> [s]"
+
+typedef Map<double,double,plusOne<double> > MapJob;
+
+class Launcher : public HR2Job {
+  MapJob **  roots;
+  int        num_roots;
+  lluint     bytes;
+
+public:
+  Launcher (MapJob ** roots_, int num_roots_, lluint bytes_)
+    : HR2Job (false), roots(roots_), num_roots(num_roots_), bytes(bytes_) {}
+
+  lluint size (const int block_size) {return round_up (bytes, block_size);}
+  lluint strand_size (const int block_size) {return 0;}
+
+  void function () {
+    for (int r=0; r<num_roots; ++r)
+      tp_run (roots[r]);
+    for (int r=0; r<num_roots; ++r)
+      tp_sync (roots[r]);
+    join ();
+  }
+};
+
+template <class S>
+lluint
+run (int n, int num_roots, bool sized) {
+  lluint budget = 3*n*sizeof(double);          // A root maps n doubles to n others
+  S * sched = new S (num_procs, num_levels, fan_outs, sizes, block_sizes, budget);
+
+  double ** A = new double*[num_roots];
+  MapJob ** roots = new MapJob*[num_roots];
+  for (int r=0; r<num_roots; ++r) {
+    A[r] = newA(double, 2*n);
+    for (int i=0; i<n; ++i)
+      A[r][i] = i+r;
+    roots[r] = new MapJob (A[r], A[r]+n, n, plusOne<double>(), 0, false);
+  }
+
+  tp_init (num_procs, map, sched);
+  Launcher * launcher = new Launcher (roots, num_roots, sized ? 2*n*sizeof(double) : 0);
+  startTime();
+  tp_run (launcher);
+  tp_sync (launcher);
+  nextTime("Total time, measured from driver program");
+  lluint deferred = sched->num_deferred ();
+
+  for (int r=0; r<num_roots; ++r) {
+    for (int i=0; i<n; ++i)
+      if (A[r][n+i] != i+r+1) {
+	std::cerr<<"Root "<<r<<" did not run: element "<<i<<" is "<<A[r][n+i]<<std::endl;
+	exit(-1);
+      }
+    delete roots[r];
+    free (A[r]);
+  }
+  delete launcher;
+  delete [] roots;
+  delete [] A;
+  tp_done ();
+  return deferred;
+}
+
+int
+main (int argv, char **argc) {
+  if (argv < 4) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int n = get_size(argv, argc, 2);
+  int num_roots = get_size(argv, argc, 3);
+  bool sized = (argv > 4 && *argc[4] == 's');
+
+  lluint deferred;
+  switch (*argc[1]) {
+  case '2': deferred = run<HR2Scheduler> (n, num_roots, sized); break;
+  case '3': deferred = run<HR3Scheduler> (n, num_roots, sized); break;
+  case '4': deferred = run<HR4Scheduler> (n, num_roots, sized); break;
+  default:
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  std::cout<<"Deferred roots: "<<deferred<<" of "<<num_roots<<std::endl;
+  if (num_roots > 1 && deferred == 0) {
+    std::cerr<<"No root was deferred under a budget that fits one"<<std::endl;
+    exit(-1);
+  }
+}
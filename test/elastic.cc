@@ -0,0 +1,128 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "common.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Shrinks and regrows the pool while a job runs. Rounds maps an array
+// back and forth; a quarter of the way in, the driver deactivates all
+// workers but the last under the schedulers without clusters, and the
+// last socket and thread 0 under the HR schedulers. It reactivates them
+// halfway, and checks every element at the end.
+//   Usage: elastic <W/2/3/4/5/6/7> <n> <rounds>
+
+#define USAGE "Usage: elastic <W/2/3/4/5/6/7> <n> <rounds>"
+
+volatile int rounds_started = 0;
+
+class Rounds : public HR2Job {
+  double *   A;
+  double *   B;
+  int        n;
+  int        rounds;
+
+public:
+  Rounds (double * A_, double * B_, int n_, int rounds_, bool del=true)
+    : HR2Job (del), A(A_), B(B_), n(n_), rounds(rounds_) {}
+
+  lluint size (const int block_size) {
+    return 2*round_up (n*sizeof(double), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    return STRAND_SIZE;
+  }
+
+  void function () {
+    if (rounds_started == rounds) {
+      join ();
+    } else {
+      bool odd = rounds_started%2;
+      ++rounds_started;
+      unary_fork (new Map<double,double,plusOne<double> > (odd ? B : A, odd ? A : B, n,
+							    plusOne<double>()),
+		  this);
+    }
+  }
+};
+
+void
+wait_for_round (int r) {
+  while (rounds_started < r)
+    usleep (100);
+}
+
+void
+set_workers (bool clusters, bool on) {
+  if (!clusters) {
+    for (int t=0; t<num_procs-1; ++t)
+      tp_set_active (t, on);
+    return;
+  }
+  if (fan_outs[0] > 1)
+    tp_set_cluster_active (1, fan_outs[0]-1, on);
+  tp_set_active (0, on);
+}
+
+int
+main (int argv, char **argc) {
+  if (argv < 4) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int n = get_size(argv, argc, 2);
+  int rounds = get_size(argv, argc, 3);
+  bool clusters = *argc[1] >= '2' && *argc[1] <= '7';
+
+  double * A = newA(double, n);
+  double * B = newA(double, n);
+  for (int i=0; i<n; ++i)
+    A[i] = i;
+
+  Scheduler *sched=create_scheduler (argv, argc);
+  startTime();
+  tp_init (num_procs, map, sched, new Rounds (A, B, n, rounds));
+
+  wait_for_round (rounds/4);
+  set_workers (clusters, false);
+  int shrunk = rounds_started;
+  wait_for_round (rounds/2);
+  set_workers (clusters, true);
+  std::cout<<"Shrunk for rounds "<<shrunk<<" to "<<rounds_started<<std::endl;
+
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+
+  double * R = rounds%2 ? B : A;
+  for (int i=0; i<n; ++i)
+    if (R[i] != i+rounds) {
+      std::cerr<<"Element "<<i<<" is "<<R[i]<<", not "<<i+rounds<<std::endl;
+      exit(-1);
+    }
+}
@@ -0,0 +1,77 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Parallel find of a key planted at a given fraction of an array. The
+// search is cancelled once some leaf finds the key; with 'n' it runs over
+// the whole array instead, as it would without cancellation.
+//   Usage: find <W/2/3/4/5/6/7> <n> <position in %> [n]
+
+#define USAGE "Usage: find <W/2/3/4/5/6/7> <n> <position in %> [n]"
+
+struct IsKey {
+  int * A; int key;
+  IsKey (int * A_, int key_) : A(A_), key(key_) {}
+  bool operator() (int i) {return A[i] == key;}
+};
+
+int
+main (int argv, char **argc) {
+  if (argv < 4) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int n = get_size(argv, argc, 2);
+  int pos = (int)((double)n*get_size(argv, argc, 3)/100);
+  bool prune = !(argv > 4 && *argc[4] == 'n');
+  if (pos < 0 || pos >= n) {
+    std::cerr<<"The position has to be in [0,100)"<<std::endl;
+    exit(-1);
+  }
+
+  int key = -1;
+  int * A = newA(int, n);
+  for (int i=0; i<n; ++i)
+    A[i] = utils::hash(i) & 0x7fffffff;
+  A[pos] = key;
+
+  int found = -1;
+  Scheduler *sched=create_scheduler (argv, argc);
+  std::cout<<"n: "<<n<<", key at: "<<pos<<(prune ? ", cancelled once found" : ", full search")<<std::endl;
+  startTime();
+  tp_init (num_procs, map, sched, new Find<IsKey> (&found, 0, n, IsKey(A, key), prune));
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+
+  if (found != pos) {
+    std::cerr<<"Found the key at "<<found<<", planted at "<<pos<<std::endl;
+    exit(-1);
+  }
+}
@@ -5,65 +5,51 @@
 
 #include <stdlib.h>
 #include <cmath>
+#include <functional>
 
 #include "ThreadPool.hh"
+#include "Reducer.hh"
 #include "machine-config.hh"
 
-class AddContJob : public SizedJob {
-  double  *_sum, *_sum1, *_sum2;
-  lluint _size;
-public:
-  AddContJob (double *sum, double *sum1, double *sum2, lluint size, bool del=true)
-    : SizedJob (del),
-      _sum (sum),
-      _sum1 (sum1),
-      _sum2 (sum2),
-      _size (size)
-  {}
-  
-  void
-  function () {
-    //std::cout<<__func__<<std::endl;
-    *_sum = *_sum1 + *_sum2;
-    //std::cout<<*_sum<<std::endl;
-    join();
-  }
-
-  lluint size (const int block_size) {return _size;}
-};
+typedef Reducer<double,std::plus<double> > Sum;
 
+// Sums _A into _sum. The leaves fold into the reducer, an inner job
+// continues as its own join, with nothing to combine.
 class AddJob : public SizedJob {
   double * _A;
   int   _len;
-  double * _sum;
+  Sum  * _sum;
   lluint _size;
+  int    _stage;
 public:
-  AddJob (double *array, int len, lluint size, bool del=true)
+  AddJob (double *array, int len, lluint size, Sum *sum, bool del=true)
     : SizedJob (del),
       _A (array),
       _len (len),
-      _size (size)
-    {_sum = new double;}
+      _sum (sum),
+      _size (size),
+      _stage (0)
+    {}
   lluint size (const int block_size) {return _size;}
   
   void
   function () {
-    if (_len <= (1<<18)) {
+    if (_stage == 1) {
+      _stage = 0;                              // The root is run again
+      join();
+    } else if (_len <= (1<<18)) {
       double sum=0;
       int length = _len;
       for (int i=0; i<length; ++i)
 	sum += _A[i];
-      *_sum=sum;
+      _sum->update (sum);
       join();
     } else {
       Job ** jobs = new Job*[2];
-      jobs[0] = new AddJob (_A, _len/2, (lluint)(1.1*(_len/2)));
-      jobs[1] = new AddJob (_A+_len/2, _len-_len/2, (lluint)(1.1*(_len-_len/2)));
-      AddContJob *sumUp = new AddContJob (_sum,
-                                          static_cast<AddJob*>(jobs[0])->_sum,
-                                          static_cast<AddJob*>(jobs[1])->_sum,
-                                          _size);
-      fork (2, jobs, sumUp);
+      jobs[0] = new AddJob (_A, _len/2, (lluint)(1.1*(_len/2)), _sum);
+      jobs[1] = new AddJob (_A+_len/2, _len-_len/2, (lluint)(1.1*(_len-_len/2)), _sum);
+      _stage = 1;
+      fork (2, jobs, this);
     }
   }
 };
@@ -73,9 +59,10 @@ void add (int num_threads) {
   double *A = new double[LEN];
   for (int i=0; i<LEN; ++i)
     A[i] = i;
-  AddJob * root = new AddJob (A, LEN, (lluint)(1.1*LEN), false);
 
   FIND_MACHINE;
+  Sum sum (num_procs);
+  AddJob * root = new AddJob (A, LEN, (lluint)(1.1*LEN), &sum, false);
   startTime();
 /*  tp_init (num_procs, map,
 	   new HR_Scheduler (num_procs,
@@ -84,9 +71,12 @@ void add (int num_threads) {
  tp_init (num_procs, NULL, new WS_Scheduler(num_procs), root);
   tp_sync_all ();
   nextTime("Done adding");
+  std::cout<<"Sum: "<<sum.get()<<std::endl;
+  sum.reset();
   tp_run (root);
   tp_sync_all();  
   nextTime("Done adding twice");
+  std::cout<<"Sum: "<<sum.get()<<std::endl;
 }
 
 int
@@ -65,8 +65,14 @@ class MatMulJob : public HR2Job {
   lluint size (const int block_size) { 
     return _A.size() + _B.size() + _C.size();
   }
+  int footprint (MemRange *ranges, int max_ranges) {
+    ranges[0] = _A.range ();
+    ranges[1] = _B.range ();
+    ranges[2] = _C.range (true);
+    return 3;
+  }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (_C.numrows<=MATMUL_BASE && _step<=1) {
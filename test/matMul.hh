@@ -61,6 +61,10 @@ struct denseMat {
   }
 
   lluint size () { return numrows*numcols*sizeof (ETYPE); }  // Not really accurate, but ok for now
+
+  MemRange range (bool write=false) {
+    return MemRange (&(*this)(0,0), numcols*sizeof (ETYPE), numrows, rowsize*sizeof (ETYPE), write);
+  }
 };
 
 
@@ -33,7 +33,7 @@ class MKLMatMulJob : public HR2Job {
     return _A.size() + _B.size() + _C.size();
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (_C.numrows<=MATMUL_BASE && _step<=1) {
@@ -3,7 +3,7 @@
 #include "errno.h"
 void
 print_usage () {
-      std::cerr<<"Usage: cmd <Sched:W/P/H/2/3/4> <args>"<<std::endl;	
+      std::cerr<<"Usage: cmd <Sched:W/P/H/2/3/4/5/6/7> <args>"<<std::endl;	
 }
 
 //FIND_MACHINE;
@@ -24,13 +24,19 @@ create_scheduler (int argv, char **argc) {
     else if (*argc[1] == 'H' || *argc[1]=='h')
       sched = new HR_Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes);
      else if (*argc[1] == '2')
-       sched = new HR2Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes, 0);
+       sched = new HR2Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes);
      else if (*argc[1] == '3')
       sched = new HR3Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes);
      else if (*argc[1] == '4')
       sched = new HR4Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes);
      else if (*argc[1] == '5')
-       sched = new HR2Scheduler (num_procs, num_levels, fan_outs, sizes, block_sizes, 1);
+       sched = new HR2TopScheduler (num_procs, num_levels, fan_outs, sizes, block_sizes);
+     else if (*argc[1] == '6')
+       sched = new HRTScheduler<AtomicReservation, Buckets<HR2Job*> >
+	 (num_procs, num_levels, fan_outs, sizes, block_sizes);
+     else if (*argc[1] == '7')
+       sched = new HRTScheduler<AtomicReservation, DistrBuckets<HR2Job*> >
+	 (num_procs, num_levels, fan_outs, sizes, block_sizes);
      else {
        print_usage();	
        exit(-1);					
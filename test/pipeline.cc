@@ -0,0 +1,230 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include <string.h>
+#include "ThreadPool.hh"
+#include "Pipeline.hh"
+#include "machine-config.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Streaming benchmark: a serial source generates chunks of a stream, a
+// Map and a Filter run over each chunk in parallel stages, and a serial
+// stage folds the kept elements into a checksum, in stream order. With
+// 'w' the same stages run as fork-join waves of <lanes> chunks instead,
+// with a barrier after each stage.
+//   Usage: pipeline <W/2/3/4/5/6/7> <chunks> <chunk len> <lanes> [w]
+
+#define USAGE "Usage: pipeline <W/2/3/4/5/6/7> <chunks> <chunk len> <lanes> [w]"
+
+struct Chunk {
+  double *   A;                                // Input, as parsed
+  double *   B;                                // After the map
+  double *   C;                                // Kept by the filter
+  int        len;
+  int        kept;
+  lluint     first;                            // Position of A[0] in the stream
+
+  Chunk () : A(NULL), B(NULL), C(NULL), len(0), kept(0), first(0) {}
+  ~Chunk () {free(A); free(B); free(C);}
+};
+
+inline double
+stream_value (lluint i) {
+  return (double)((i*2654435761ULL) % 1000003) / 1000003.0;
+}
+
+class Generate : public PipeSource<Chunk> {
+  lluint     num_chunks;
+  int        len;
+  lluint     next;
+public:
+  Generate (lluint num_chunks_, int len_) : num_chunks(num_chunks_), len(len_), next(0) {}
+  void reset () {next = 0;}
+
+  bool fill (Chunk * c) {
+    if (next == num_chunks)
+      return false;
+    if (c->A == NULL) {                        // First touched in the cluster of the lane
+      c->A = newA(double,len); c->B = newA(double,len); c->C = newA(double,len);
+    }
+    c->len = len;
+    c->first = next*len;
+    for (int i=0; i<len; ++i)
+      c->A[i] = stream_value (c->first+i);
+    ++next;
+    return true;
+  }
+};
+
+struct logistic {
+  double operator() (double x) {return 4*x*(1-x);}
+};
+
+struct above {
+  double * B; double t;
+  above (double * B_, double t_) : B(B_), t(t_) {}
+  bool operator() (int i) {return B[i] > t;}
+};
+
+class MapStage : public PipeStage<Chunk> {
+public:
+  MapStage () : PipeStage<Chunk> (false) {}
+  HR2Job* process (Chunk * c) {
+    return new Map<double,double,logistic> (c->A, c->B, c->len, logistic());
+  }
+};
+
+class FilterStage : public PipeStage<Chunk> {
+public:
+  FilterStage () : PipeStage<Chunk> (false) {}
+  HR2Job* process (Chunk * c) {
+    return new Filter<double,above,getA<double> > (&c->kept, c->C, 0, c->len,
+						   above(c->B, 0.75), getA<double>(c->B));
+  }
+};
+
+class Aggregate : public PipeStage<Chunk> {
+public:
+  lluint     next;                             // Expected first of the next chunk
+  lluint     kept;
+  double     sum;
+  bool       in_order;
+  Aggregate () : PipeStage<Chunk> (true) {reset ();}
+  void reset () {next = 0; kept = 0; sum = 0; in_order = true;}
+
+  HR2Job* process (Chunk * c) {
+    if (c->first != next)
+      in_order = false;
+    next = c->first + c->len;
+    for (int i=0; i<c->kept; ++i)
+      sum += c->C[i];
+    kept += c->kept;
+    return NULL;
+  }
+};
+
+// The stages as fork-join waves: fill up to num_lanes chunks, then run
+// each stage over all of them and wait. Serial stages run inline.
+class Waves : public HR2Job {
+  PipeSource<Chunk> *  source;
+  PipeStage<Chunk> **  stages;
+  int                  num_stages;
+  Chunk *              chunks;
+  int                  num_lanes;
+  lluint               chunk_bytes;
+  int                  num_filled;
+  int                  stage;
+
+public:
+  Waves (PipeSource<Chunk> * source_, int num_stages_, PipeStage<Chunk> ** stages_,
+	 int num_lanes_, lluint chunk_bytes_, bool del=true)
+    : HR2Job (del), source(source_), stages(stages_), num_stages(num_stages_),
+      chunks(new Chunk[num_lanes_]), num_lanes(num_lanes_), chunk_bytes(chunk_bytes_),
+      num_filled(0), stage(0) {}
+  ~Waves () {delete [] chunks;}
+
+  lluint size (const int block_size) {return num_lanes*round_up(chunk_bytes, block_size);}
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1) {
+      return size(block_size);
+    } else {
+      return STRAND_SIZE;
+    }
+  }
+
+  void function () {
+    for (;;) {
+      if (stage == 0) {
+	num_filled = 0;
+	while (num_filled < num_lanes && source->fill (&chunks[num_filled]))
+	  ++num_filled;
+	if (num_filled == 0) {
+	  join ();
+	  return;
+	}
+	stage = 1;
+      }
+      PipeStage<Chunk> * st = stages[stage-1];
+      Job ** jobs = new Job*[num_filled];
+      int num_jobs = 0;
+      for (int i=0; i<num_filled; ++i) {
+	HR2Job * job = st->process (&chunks[i]);
+	if (job != NULL)
+	  jobs[num_jobs++] = job;
+      }
+      stage = (stage == num_stages) ? 0 : stage+1;
+      if (num_jobs > 0) {
+	fork (num_jobs, jobs, this);
+	return;
+      }
+      delete [] jobs;
+    }
+  }
+};
+
+int
+main (int argv, char **argc) {
+  if (argv < 5) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  lluint num_chunks = get_size(argv, argc, 2);
+  int len = get_size(argv, argc, 3);
+  int num_lanes = get_size(argv, argc, 4);
+  bool waves = (argv > 5 && *argc[5] == 'w');
+  lluint chunk_bytes = 3*len*sizeof(double) + len*sizeof(bool);
+
+  Generate source (num_chunks, len);
+  MapStage map_stage; FilterStage filter_stage; Aggregate aggregate;
+  PipeStage<Chunk> * stages[3] = {&map_stage, &filter_stage, &aggregate};
+
+  Scheduler *sched=create_scheduler (argv, argc);
+  std::cout<<"Chunks: "<<num_chunks<<", len: "<<len<<", lanes: "<<num_lanes
+	   <<(waves ? ", fork-join waves" : ", pipelined")<<std::endl;
+  Job * root = waves
+    ? (Job*) new Waves (&source, 3, stages, num_lanes, chunk_bytes)
+    : (Job*) new Pipeline<Chunk> (&source, 3, stages, num_lanes, chunk_bytes);
+  startTime();
+  tp_init (num_procs, map, sched, root);
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+
+  lluint kept = 0; double sum = 0;
+  for (lluint i=0; i<num_chunks*len; ++i) {
+    double b = logistic() (stream_value (i));
+    if (b > 0.75) {
+      ++kept;
+      sum += b;
+    }
+  }
+  std::cout<<"Kept: "<<aggregate.kept<<", sum: "<<aggregate.sum<<std::endl;
+  if (!aggregate.in_order || aggregate.kept != kept || aggregate.next != num_chunks*len
+      || fabs (aggregate.sum-sum) > 1e-6*sum) {
+    std::cerr<<"Check failed"<<std::endl;
+    exit(-1);
+  }
+}
@@ -0,0 +1,178 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Runs Map under each reservation/bucket/lock combination of HRTScheduler,
+// either through the virtual Scheduler interface (tp_init) or through
+// a StaticThreadPool that calls the scheduler's get directly.
+//   Usage: policyMap <2/3/4/5/6/7> <v/s> <len> [cluster lock: m/t/k/q/c] [a][w][n][i]
+//   m: Mutex (default), t: TTASLock, k: TicketLock, q: MCSLock, c: CLHLock
+//   a: adapt SIGMA/MU online, w: warm caches with the footprint of new pins
+//   n: move the pages of tasks pinned to a socket to its NUMA node
+//   i: run on an irregular tree of the machine's depth, see irregular_tree
+
+#define USAGE "Usage: policyMap <2/3/4/5/6/7> <v/s> <len> [m/t/k/q/c] [a][w][n][i]"
+
+bool adapt = false;
+bool warm = false;
+bool numa = false;
+bool irregular = false;
+
+// A tree with the depth and cache sizes of the machine, but unequal
+// fan-outs: each cache splits its threads two to one among its children,
+// and a cache of one thread has a single child, padding the tree to full
+// depth. The last cache level keeps all its threads as leaves.
+CacheNode *
+irregular_tree (int & num_nodes) {
+  std::vector<CacheNode> nodes;
+  std::vector<int> threads (1, num_procs);     // Below each node of the level
+  for (int l=0; l<num_levels; ++l) {
+    std::vector<int> below;
+    for (size_t i=0; i<threads.size(); ++i) {
+      int t = threads[i];
+      CacheNode node = {0, sizes[l], block_sizes[l]};
+      if (l == num_levels-1) {
+	node._num_children = t;
+	below.insert (below.end(), t, 0);
+      } else if (t == 1) {
+	node._num_children = 1;
+	below.push_back (1);
+      } else {
+	node._num_children = 2;
+	below.push_back (t-t/3);
+	below.push_back (t/3);
+      }
+      nodes.push_back (node);
+    }
+    threads = below;
+  }
+  for (size_t i=0; i<threads.size(); ++i) {
+    CacheNode leaf = {0, 0, 1};
+    nodes.push_back (leaf);
+  }
+  num_nodes = nodes.size();
+  CacheNode * ret = new CacheNode[num_nodes];
+  std::copy (nodes.begin(), nodes.end(), ret);
+  return ret;
+}
+
+template <class Sched>
+void
+run_map (Sched * sched, bool static_pool, double *A, double *B, int LEN) {
+  Job * root = new Map<double, double, plusOne<double> >(A, B, LEN, plusOne<double>());
+  flush_cache(num_procs,sizes[1]);
+  startTime();
+  if (static_pool)
+    tp_init_static (num_procs, map, sched, root);
+  else
+    tp_init (num_procs, map, sched, root);
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+}
+
+template <class Reservation, class BucketSet, class Lock>
+void
+run_map (bool static_pool, double *A, double *B, int LEN) {
+  HRTScheduler<Reservation, BucketSet, Lock> * sched;
+  if (irregular) {
+    int num_nodes;
+    CacheNode * nodes = irregular_tree (num_nodes);
+    sched = new HRTScheduler<Reservation, BucketSet, Lock> (num_procs, num_nodes, nodes);
+    delete [] nodes;
+  } else {
+    sched = new HRTScheduler<Reservation, BucketSet, Lock> (num_procs, num_levels, fan_outs, sizes, block_sizes);
+  }
+  if (adapt)
+    sched->enable_adaptation ();
+  if (warm)
+    sched->enable_warming ();
+  if (numa)
+    sched->enable_numa_placement ();
+  run_map (sched, static_pool, A, B, LEN);
+}
+
+template <class Lock>
+void
+run_policy (char policy, bool static_pool, double *A, double *B, int LEN) {
+  switch (policy) {
+  case '2': run_map<LockedReservation, Buckets<HR2Job*>, Lock >         (static_pool, A, B, LEN); break;
+  case '3': run_map<AtomicReservation, TopDistrBuckets<HR2Job*>, Lock > (static_pool, A, B, LEN); break;
+  case '4': run_map<LockedReservation, DistrBuckets<HR2Job*>, Lock >    (static_pool, A, B, LEN); break;
+  case '5': run_map<LockedReservation, TopDistrBuckets<HR2Job*>, Lock > (static_pool, A, B, LEN); break;
+  case '6': run_map<AtomicReservation, Buckets<HR2Job*>, Lock >         (static_pool, A, B, LEN); break;
+  case '7': run_map<AtomicReservation, DistrBuckets<HR2Job*>, Lock >    (static_pool, A, B, LEN); break;
+  default:
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+}
+
+int
+main (int argv, char **argc) {
+  if (argv < 3) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int LEN = (-1==get_size(argv, argc,3)) ? 100000000 : get_size(argv, argc,3);
+  bool static_pool = (*argc[2] == 's' || *argc[2] == 'S');
+  adapt = (argv > 5 && strchr (argc[5], 'a') != NULL);
+  warm = (argv > 5 && strchr (argc[5], 'w') != NULL);
+  numa = (argv > 5 && strchr (argc[5], 'n') != NULL);
+  irregular = (argv > 5 && strchr (argc[5], 'i') != NULL);
+
+  double* A = new double[LEN];
+  double* B = new double[LEN];
+  for (int i=0; i<LEN; ++i) {
+    A[i] = i;   B[i] = 0;
+  }
+  std::cout<<"Len: "<<LEN<<", "<<(static_pool ? "static" : "virtual")<<" dispatch"
+	   <<(irregular ? ", irregular tree" : "")<<std::endl;
+
+  switch (argv > 4 ? *argc[4] : 'm') {
+  case 'm': run_policy<Mutex>      (*argc[1], static_pool, A, B, LEN); break;
+  case 't': run_policy<TTASLock>   (*argc[1], static_pool, A, B, LEN); break;
+  case 'k': run_policy<TicketLock> (*argc[1], static_pool, A, B, LEN); break;
+  case 'q': run_policy<MCSLock>    (*argc[1], static_pool, A, B, LEN); break;
+  case 'c': run_policy<CLHLock>    (*argc[1], static_pool, A, B, LEN); break;
+  default:
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+
+  for (int i=0; i<LEN; ++i)
+    if (B[i] != A[i]+1) {
+      std::cerr<<"Check failed at "<<i<<std::endl;
+      exit(-1);
+    }
+}
@@ -0,0 +1,126 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include <functional>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "sequence-jobs.hh"
+#include "parse-args.hh"
+
+// Latency of small requests co-running with bulk work in one pool. A bulk
+// root maps a large array over and over at the lowest priority while the
+// driver runs requests, small reductions, one after the other at the
+// highest priority and times each from tp_run to tp_sync. With 'n' the
+// requests run at the priority of the bulk work instead.
+//   Usage: priority <W/2/3/4/5/6/7> <bulk len> <request len> <requests> [n]
+
+#define USAGE "Usage: priority <W/2/3/4/5/6/7> <bulk len> <request len> <requests> [n]"
+
+struct Scale {double operator() (double x) {return 1.0001*x+1e-6;}};
+
+struct Get {
+  double * A;
+  Get (double * A_) : A(A_) {}
+  double operator() (int i) {return A[i];}
+};
+
+volatile bool requests_done = false;
+
+class Bulk : public HR2Job {
+  double *   A;
+  double *   B;
+  int        n;
+  int        rounds;
+
+public:
+  Bulk (double * A_, double * B_, int n_, bool del=true)
+    : HR2Job (del), A(A_), B(B_), n(n_), rounds(0) {}
+
+  lluint size (const int block_size) {
+    return 2*round_up (n*sizeof(double), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    return STRAND_SIZE;
+  }
+
+  void function () {
+    if (requests_done) {
+      std::cout<<"Bulk rounds: "<<rounds<<std::endl;
+      join ();
+    } else {
+      ++rounds;
+      unary_fork (new Map<double,double,Scale> (A, B, n, Scale()), this);
+    }
+  }
+};
+
+int
+main (int argv, char **argc) {
+  if (argv < 5) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int n = get_size(argv, argc, 2);
+  int m = get_size(argv, argc, 3);
+  int num_requests = get_size(argv, argc, 4);
+  int priority = (argv > 5 && *argc[5] == 'n') ? 0 : NUM_PRIORITIES-1;
+
+  double * A = newA(double, n);
+  double * B = newA(double, n);
+  double * R = newA(double, m);
+  for (int i=0; i<n; ++i)
+    A[i] = 1.0/(i+1);
+  for (int i=0; i<m; ++i)
+    R[i] = 1.0;
+
+  Scheduler *sched=create_scheduler (argv, argc);
+  std::cout<<"bulk: "<<n<<", requests of "<<m<<" at priority "<<priority<<std::endl;
+  startTime();
+  tp_init (num_procs, map, sched, new Bulk (A, B, n));
+
+  ull_t total=0, worst=0;
+  for (int r=0; r<num_requests; ++r) {
+    double sum = 0;
+    Job * req = new Reduce<double,std::plus<double>,Get> (&sum, 0, m, std::plus<double>(), Get(R),
+							   NULL, false);
+    req->set_priority (priority);
+    ull_t start = get_time_nanosec ();
+    tp_run (req);
+    tp_sync (req);
+    ull_t latency = get_time_nanosec () - start;
+    delete req;
+    total += latency;
+    worst = std::max (worst, latency);
+    if (sum != m) {
+      std::cerr<<"Request "<<r<<" summed to "<<sum<<", not "<<m<<std::endl;
+      exit(-1);
+    }
+  }
+  requests_done = true;
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+  std::cout<<"Request latency: avg "<<total/num_requests/1000<<" us, max "<<worst/1000<<" us"<<std::endl;
+}
@@ -186,7 +186,7 @@ public:
     return 2*round_up((n+1)*sizeof(Point<E>), block_size)+5*round_up((n+1)*sizeof(int), block_size);
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) 
+    if (tp_options._strand_size_mode==1) 
       return size (block_size); 
     else 
       if (stage == 0 && n<_SCAN_BSIZE) 
@@ -338,7 +338,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (stage==0 && n<QSORT_PAR_THRESHOLD) {
@@ -74,12 +74,19 @@ struct makePair {
 struct minMaxIndex {
   point2d* P;
   minMaxIndex (point2d* _P) : P(_P) {}
+  // Ties go by y, then by index, so that the result does not depend on
+  // the order Reduce merges its views in
   pair<int,int> operator () (pair<int,int> l, pair<int,int> r) {
+    int a = l.first, b = r.first;
     int minIndex = 
-      (P[l.first].x < P[r.first].x) ? l.first :
-      (P[l.first].x > P[r.first].x) ? r.first :
-      (P[l.first].y < P[r.first].y) ? l.first : r.first;
-    int maxIndex = (P[l.second].x > P[r.second].x) ? l.second : r.second;
+      (P[a].x != P[b].x) ? (P[a].x < P[b].x ? a : b) :
+      (P[a].y != P[b].y) ? (P[a].y < P[b].y ? a : b) :
+      (a < b ? a : b);
+    a = l.second; b = r.second;
+    int maxIndex = 
+      (P[a].x != P[b].x) ? (P[a].x > P[b].x ? a : b) :
+      (P[a].y != P[b].y) ? (P[a].y > P[b].y ? a : b) :
+      (a < b ? a : b);
     return pair<int,int>(minIndex, maxIndex);
   }
 };
@@ -153,16 +160,29 @@ struct triangArea {
   double operator() (int i) {return triArea(P[l], P[r], P[I[i]]);}
 };
  
+// The larger of two (value, index) pairs under f, the lower index on ties
+template <class ET, class F>
+struct maxPair {
+  F f;
+  maxPair (F f_) : f(f_) {}
+  pair<ET,int> operator() (const pair<ET,int>& a, const pair<ET,int>& b) {
+    if (f(a.first,b.first)) return a;
+    if (f(b.first,a.first)) return b;
+    return a.second < b.second ? a : b;
+  }
+};
+
 template <class ET, class F, class G>
 class MaxIndex : public HR2Job {
+  typedef Reducer<pair<ET,int>,maxPair<ET,F> > Views;
   int *ret; int s, e; F f; G g;
-  int stage; int* ret1; int* ret2;
+  Views* views; int stage;
 
 public:
   MaxIndex (int *ret_, int s_, int e_, F f_, G g_,
-	    int stage_=0, int* ret1_=NULL, int* ret2_=NULL, bool del=true)
+	    Views* views_=NULL, bool del=true)
     : HR2Job(del), ret(ret_), s(s_), e(e_), f(f_), g(g_), 
-      ret1(ret1_), ret2(ret2_),stage(stage_) {}
+      views(views_), stage(0) {}
 
   //MaxIndex (int *ret_, ET* A, int n, F f_)
   //  : HR2Job(del), ret(ret_), s(0), e(n), f(f_), g(getA<ET,int>(A)), stage(stage_) {}
@@ -174,22 +194,27 @@ public:
     if (stage == 0) {
       if (e-s < _SCAN_BSIZE) {
 	ET r = g(s);
-	int k = 0;
+	int k = s;
 	for (int j=s+1; j < e; j++) {
 	  ET v = g(j);
 	  if (f(v,r)) { r = v; k = j;}
 	}
-	*ret = k;
+	if (views == NULL) *ret = k; else views->update (pair<ET,int>(r,k));
 	join();
       } else {
-	int *ret1 = newA(int,1); int *ret2 = newA (int,1);
+	if (views == NULL)
+	  views = new Views (get_thread()->get_pool()->max_parallel(), maxPair<ET,F>(f));
 	int m=(s+e)/2;
-	binary_fork (new MaxIndex<ET,F,G>(ret1,s,m,f,g),
-		     new MaxIndex<ET,F,G>(ret2,m,e,f,g),
-		     new MaxIndex<ET,F,G>(ret,s,e,f,g,1,ret1,ret2));
+	stage = 1;                // Continue as the join, the views are merged there
+	binary_fork (new MaxIndex<ET,F,G>(NULL,s,m,f,g,views),
+		     new MaxIndex<ET,F,G>(NULL,m,e,f,g,views),
+		     this);
       }
     } else {
-      *ret = f(g(*ret1),g(*ret2)) ? *ret1 : *ret2;
+      if (ret != NULL) {
+	*ret = views->get().second;
+	delete views;
+      }
       join();
     }
   }
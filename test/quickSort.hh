@@ -31,6 +31,7 @@
 #include <functional>
 #include "sequence-jobs.hh"
 #include "Job.hh"
+#include "Coroutine.hh"
 #include "utils.hh"
 
 using namespace std;
@@ -229,8 +230,8 @@ public:
 	PositionScanPlus lessScanPlus(LESS);
 
 	
-	less_pos_n = newA(int,1);
-	more_pos_n = newA(int,1);
+	less_pos_n = (int*) scratch (sizeof(int));
+	more_pos_n = (int*) scratch (sizeof(int));
 	unary_fork (new Scan<int,PositionScanPlus >(less_pos_n,compared,less_pos,n,lessScanPlus,0),
 		    new QuickSort<E,BinPred>(this));
 
@@ -270,6 +271,57 @@ public:
   }
 };
 
+#if TP_COROUTINES
+// QuickSort with its stages as one coroutine body, see Coroutine.hh. The
+// counts of the scans are locals of the body, not scratch of the job.
+template <class E, class BinPred>
+class CoQuickSort : public CoJob {
+  E *A, *B; int n;
+  int *compared;
+  int *less_pos, *more_pos;
+  BinPred f; bool invert;
+
+public:
+  CoQuickSort (E* A_, int n_, BinPred f_,
+	       int* compared_, int* less_pos_, int* more_pos_, E* B_,
+	       bool invert_=0, bool del=true)
+    : CoJob (del), A(A_), B(B_), n(n_), compared(compared_),
+      less_pos(less_pos_), more_pos(more_pos_), f(f_), invert(invert_) {}
+
+  lluint size (const int block_size) {
+    return round(quickSortSize<E>(n,block_size));
+  }
+  lluint strand_size (const int block_size) {
+    return size(block_size);
+  }
+
+  CoBody body () {
+    if (n < QSORT_PAR_THRESHOLD) {
+      seqQuickSort (A,n,f,B,invert);
+      co_return;
+    }
+    E sample[3] = {A[0], A[n/3], A[2*(n/3)]};
+    seqQuickSort (sample,3,f);
+    E pivot = sample[1];
+
+    co_await spawn (new Map<E,int,CompareWithPivot<E> > (A,compared,n,CompareWithPivot<E>(pivot)));
+
+    int less_n, more_n;
+    co_await spawn (new Scan<int,PositionScanPlus >(&less_n,compared,less_pos,n,PositionScanPlus(LESS),0));
+    co_await spawn (new Scan<int,PositionScanPlus >(&more_n,compared,more_pos,n,PositionScanPlus(MORE),0));
+    co_await spawn (new FilterLR<E> (A,B,B+less_n,B+n-more_n,less_pos,more_pos,compared,0,n));
+
+    int more_els = n-more_n;
+    co_await spawn (new CoQuickSort<E,BinPred>(B,less_n,f,compared,less_pos,more_pos,A,!invert),
+		    new CoQuickSort<E,BinPred>(B+more_els,more_n,f,compared+more_els,
+					       less_pos+more_els,more_pos+more_els,
+					       A+more_els,!invert));
+    if (!invert)
+      co_await spawn (new Map<E,E,Id<E> >(B+less_n,A+less_n,n-less_n-more_n,Id<E>()));
+  }
+};
+#endif
+
 template <class E, class BinPred>
 bool
 checkSort (E* A, int n, BinPred f) {
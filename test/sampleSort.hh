@@ -86,13 +86,16 @@ public:
       stage (from->stage+1)
     {}
   
-  lluint size (const int block_size) {
+  static lluint size_of (int A_size, int numSegs, const int block_size) {
     return round_up(sampleSortSizeInBytes<E>(A_size), block_size)
       + round_up(numSegs*sizeof(E), block_size)
       + round_up(numSegs*sizeof(int), block_size);
   }
+  lluint size (const int block_size) {
+    return size_of (A_size, numSegs, block_size);
+  }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (stage==0)
@@ -113,8 +116,10 @@ public:
   }
 };
 
+// Bodies and range sizes of the two Pfors of a sample sort: first each
+// row is sorted and merged with the pivots, then each segment is sorted
 template <class E, class BinPred>
-class GenerateSortAndMergeObjects : public JobGenerator {
+class GenerateSortAndMergeObjects {
 
   E* A; BinPred f;
   E* pivots; int*segSizes; int numSegs, rowSize, numR, n;
@@ -137,7 +142,25 @@ public :
 };
 
 template <class E, class BinPred>
-class GenerateSortObjects2 : public JobGenerator {
+class SortAndMergeSizes {
+  int numSegs, rowSize, numR, n;
+
+public:
+  SortAndMergeSizes (int numSegs_, int rowSize_, int numR_, int n_)
+    : numSegs(numSegs_), rowSize(rowSize_), numR(numR_), n(n_)
+    {}
+
+  lluint operator()(int s, int e, const int block_size) {
+    lluint row = SortAndMerge<E,BinPred>::size_of (rowSize, numSegs, block_size);
+    if (e < numR)
+      return (e-s)*row;
+    return (e-1-s)*row                            // The last row may be short
+      + SortAndMerge<E,BinPred>::size_of (n - (numR-1)*rowSize, numSegs, block_size);
+  }
+};
+
+template <class E, class BinPred>
+class GenerateSortObjects2 {
 
   E* A;
   int *offsetB; int numR; BinPred f; int n; int numSegs;
@@ -158,6 +181,7 @@ public :
       // if not all equal in the segment
       if (f(pivots[i-1],pivots[i])) 
 	return new SampleSort<E, BinPred> (A+offsetB[i*numR], offsetB[(i+1)*numR] - offsetB[i*numR], f);
+      return NULL;
     } else { // last segment
       //std::cout<<"Last: "<<n<<" "<< n - offsetB[i*numR]<<std::endl;
       return new SampleSort<E, BinPred> (A+offsetB[i*numR], n - offsetB[i*numR], f);
@@ -165,6 +189,21 @@ public :
   }
 };
 
+template <class E>
+class SortObjects2Sizes {
+  int *offsetB; int numR; int n; int numSegs;
+
+public:
+  SortObjects2Sizes (int *offsetB_, int numSegs_, int numR_, int n_)
+    : offsetB(offsetB_), numR(numR_), n(n_), numSegs(numSegs_)
+    {}
+
+  lluint operator()(int s, int e, const int block_size) {
+    int end = e < numSegs ? offsetB[e*numR] : n;
+    return SizedJob::round_up (sampleSortSizeInBytes<E>(end - offsetB[s*numR]), block_size);
+  }
+};
+
 #define SSORT_THR 200000
 #define AVG_SEG_SIZE 2
 #define PIVOT_QUOT 2
@@ -177,9 +216,6 @@ class SampleSort : public HR2Job {
   int sq, rowSize, numR, numSegs, overSample, sampleSetSize;
   E *sampleSet;  E *pivots;  E *B;
   int *segSizes;  int *offsetA;  int *offsetB;
-  HR2Job ***first_sort_objects;  lluint **first_sort_size_sums_ptr;
-  HR2Job ***second_sort_objects;  lluint **second_sort_size_sums_ptr;
-  HR2Job **merge_objects;
   lluint *bt_sizes; char* space;
   int stage;
 
@@ -187,14 +223,12 @@ public:
   enum SORT_STAGES {
     ST_SORT_SAMPLES = 10,
     ST_SUBSELECT ,
-    ST_FIRST_SORT,
     ST_A_OFFSETS,
     ST_A_TRANSPOSE,
     ST_B_OFFSETS,
     ST_BLOCK_TRANSPOSE_SIZE,
     ST_BLOCK_TRANSPOSE,
     ST_COPY_BACK,
-    ST_SECOND_SORT_SIZING,
     ST_SECOND_SORT,
     ST_CLEAN_UP,
     ST_END
@@ -217,9 +251,7 @@ public:
       sampleSetSize(from->sampleSetSize), sampleSet(from->sampleSet), 
       pivots(from->pivots),  B(from->B),
       segSizes(from->segSizes), offsetA(from->offsetA), offsetB(from->offsetB),
-      first_sort_objects (from->first_sort_objects), first_sort_size_sums_ptr (from->first_sort_size_sums_ptr),
-      second_sort_objects (from->second_sort_objects), second_sort_size_sums_ptr (from->second_sort_size_sums_ptr),
-      merge_objects(from->merge_objects), space(from->space),
+      space(from->space),
       bt_sizes(from->bt_sizes) {
     if (stage_==-1)
       stage = from->stage+1;
@@ -232,7 +264,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size (block_size);
     } else {
       return STRAND_SIZE;
@@ -255,25 +287,27 @@ public:
 	sampleSetSize = numSegs*overSample;
 
 	if (space == NULL) {
-	  sampleSet = newA(E,sampleSetSize);
+	  sampleSet = newA(E,sampleSetSize);      // Freed once the pivots are picked
 	} else {
 	  sampleSet = (E*) space;
 	  space += sizeof(E)*sampleSetSize;
 	}
 	
 	Hash<E> hash(A, n);
+	stage = ST_SORT_SAMPLES;
 	unary_fork (new MapInt<E,Hash<E> > (sampleSet, sampleSetSize, hash),
-		    new SampleSort<E, BinPred> (this,ST_SORT_SAMPLES));
+		    this);
       }
 
     } else if (stage == ST_SORT_SAMPLES) {
 
+      ++stage;
       unary_fork (new QuickSort<E, BinPred> (sampleSet, sampleSetSize, f),
-		  new SampleSort<E, BinPred> (this));
+		  this);
        
     } else if (stage == ST_SUBSELECT) {
       if (space == NULL) {
-	pivots = newA(E,numSegs-1);
+	pivots = (E*) scratch (sizeof(E)*(numSegs-1));
       } else {
 	pivots = (E*)space;
 	space += sizeof(E)*(numSegs-1);
@@ -285,11 +319,11 @@ public:
       }
       
       if (space == NULL) {
-	free(sampleSet);  
-	B = newA(E, numR*rowSize);
-	segSizes = newA(int, numR*numSegs+1);
-	offsetA = newA(int, numR*numSegs+1);
-	offsetB = newA(int, numR*numSegs+1);
+	free(sampleSet);
+	B = (E*) scratch (sizeof(E)*(numR*rowSize));
+	segSizes = (int*) scratch (sizeof(int)*(numR*numSegs+1));
+	offsetA = (int*) scratch (sizeof(int)*(numR*numSegs+1));
+	offsetB = (int*) scratch (sizeof(int)*(numR*numSegs+1));
       } else {
 	B = (E*)space; space += sizeof(E)*(numR*rowSize);
 	segSizes = (int*)space; space += sizeof(int)*(numR*numSegs+1);
@@ -297,69 +331,61 @@ public:
 	offsetB = (int*)space; space += sizeof(int)*(numR*numSegs+1);
       }
 	
-      first_sort_objects = new HR2Job**;
-      first_sort_size_sums_ptr = new lluint*;
-      unary_fork ( new Pfor (new GenerateSortAndMergeObjects<E, BinPred>
-			     (A, f, pivots, segSizes, numSegs, rowSize, numR, n),
-			     numR, NULL, ST_GEN_JOBS, first_sort_objects, first_sort_size_sums_ptr),
-		   new SampleSort<E,BinPred> (this));
-
-    } else if (stage == ST_FIRST_SORT) {
-
-      unary_fork (new Pfor (*first_sort_objects, numR, *first_sort_size_sums_ptr),
-		  new SampleSort<E,BinPred> (this));
+      ++stage;
+      unary_fork (new Pfor<GenerateSortAndMergeObjects<E,BinPred>, SortAndMergeSizes<E,BinPred> >
+		  (GenerateSortAndMergeObjects<E,BinPred> (A, f, pivots, segSizes, numSegs, rowSize, numR, n),
+		   SortAndMergeSizes<E,BinPred> (numSegs, rowSize, numR, n),
+		   0, numR),
+		  this);
       
     } else if (stage == ST_A_OFFSETS) {
 
-      unary_fork (new Scan<int, plus<int> > (new int, segSizes, offsetA, numR*numSegs+1, plus<int>(),0),
-		  new SampleSort<E, BinPred> (this));
+      ++stage;
+      unary_fork (new Scan<int, plus<int> > ((int*)scratch(sizeof(int)), segSizes, offsetA, numR*numSegs+1, plus<int>(),0),
+		  this);
 
     } else if (stage == ST_A_TRANSPOSE) {
 
+      ++stage;
       unary_fork (new Transpose<int>(segSizes, offsetB, numR, numSegs),
-		  new SampleSort<E, BinPred> (this));
+		  this);
 
     } else if (stage == ST_B_OFFSETS) {
 
-      unary_fork (new Scan<int, plus<int> > (new int, offsetB, offsetB, numR*numSegs+1, plus<int>(),0),
-		  new SampleSort<E, BinPred> (this));
+      ++stage;
+      unary_fork (new Scan<int, plus<int> > ((int*)scratch(sizeof(int)), offsetB, offsetB, numR*numSegs+1, plus<int>(),0),
+		  this);
 
     } else if (stage == ST_BLOCK_TRANSPOSE_SIZE) {
 
       bt_sizes = new lluint [8*numR*numSegs/_PAR_TRANS_THRESHHOLD];
+      ++stage;
       unary_fork (new BlockTranspose<E>(A, B, offsetA, offsetB, segSizes, numR, numSegs, BT_ST_SIZE, bt_sizes),
-		  new SampleSort<E, BinPred> (this));
+		  this);
 
     } else if (stage == ST_BLOCK_TRANSPOSE) {
 
+      ++stage;
       unary_fork (new BlockTranspose<E>(A, B, offsetA, offsetB, segSizes, numR, numSegs, 0, bt_sizes),
-		  new SampleSort<E, BinPred> (this));
+		  this);
 
     } else if (stage == ST_COPY_BACK) {
 
+      ++stage;
       unary_fork (new Map<E, E, Id<E> > (B, A, n, Id<E>() ),
-		  new SampleSort<E, BinPred> (this));
-
-    } else if (stage == ST_SECOND_SORT_SIZING) {
-
-      second_sort_objects = new HR2Job**;
-      second_sort_size_sums_ptr = new lluint*;
-      unary_fork (new Pfor (new GenerateSortObjects2<E,BinPred>
-			    (A, pivots, offsetB, numSegs, numR, n, f),
-			    numSegs, NULL, ST_GEN_JOBS, second_sort_objects, second_sort_size_sums_ptr),
-		  new SampleSort<E, BinPred> (this));
+		  this);
 
     } else if (stage == ST_SECOND_SORT) {
 
-      unary_fork (new Pfor (*second_sort_objects, numSegs, *second_sort_size_sums_ptr),
-		  new SampleSort<E, BinPred> (this));
+      ++stage;
+      unary_fork (new Pfor<GenerateSortObjects2<E,BinPred>, SortObjects2Sizes<E> >
+		  (GenerateSortObjects2<E,BinPred> (A, pivots, offsetB, numSegs, numR, n, f),
+		   SortObjects2Sizes<E> (offsetB, numSegs, numR, n),
+		   0, numSegs),
+		  this);
       
     } else if (stage == ST_CLEAN_UP) {
-      if (space == NULL)  {
-	free(pivots); free(offsetB); 
-	free(B); free(offsetA); free(segSizes);
-      }
-      join();
+      join();                                     // Releases the scratch arrays
 
     } else if (stage == ST_END) {
 
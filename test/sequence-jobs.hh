@@ -32,6 +32,8 @@
 #include <iostream>
 #include "utils.hh"
 #include "Job.hh"
+#include "Reducer.hh"
+#include "Cancel.hh"
 #include "recursion_basecase.hh"
 #include "common.hh"
 
@@ -164,7 +166,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size (block_size);
     } else { 
       if (n > _SCAN_BSIZE)
@@ -177,7 +179,7 @@ public:
   void function () {
     if (stage == 0) {
       if (n<_SCAN_BSIZE/4) {
-	for (volatile int i=0; i<n; ++i)
+	for (volatile int i=0; i<n; i=i+1)
 	  B[0] += f(A[0]);
 	join ();
       } else {
@@ -206,8 +208,14 @@ public:
     return round_up(n*sizeof(AT), block_size) + round_up(n*sizeof(BT), block_size);
   }
 
+  int footprint (MemRange *ranges, int max_ranges) {
+    ranges[0] = MemRange (A, n*sizeof(AT));
+    ranges[1] = MemRange (B, n*sizeof(BT), true);
+    return 2;
+  }
+
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size (block_size);
     } else { 
       if (n > _SCAN_BSIZE)
@@ -252,7 +260,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size (block_size);
     } else { 
       if (e-s > _SCAN_BSIZE)
@@ -280,55 +288,24 @@ public:
   }
 };
 
-template <class ET, class F>
-class ScanUpRCont : public HR2Job {
-
-  F f;
-  ET* Sums;
-  ET* result; ET* result1;ET* result2;
-  int s,e;
-
-public:
-  ScanUpRCont(ET* result_, ET* result1_, ET* result2_, ET* Sums_, F f_,
-	      int s_, int e_,
-	      bool del=true)
-    : HR2Job (del),
-      Sums (Sums_), f(f_), s(s_), e(e_),
-      result(result_), result1(result1_), result2(result2_)
-    {}
-
-  lluint size (const int block_size) {
-    return round_up((e-s)*sizeof(ET), block_size)
-      + round_up (((e-s)/_SCAN_BSIZE)*sizeof(ET), block_size);;
-  }
-  lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE ==1) {
-      return size(block_size);
-    } else {
-      return STRAND_SIZE;
-    }
-  }
-
-  void function () {
-    *Sums = *result1;
-    *result = f (*result1, *result2);
-    //delete result1, result2;
-    join ();
-  }
-};
-
+// Up-sweep of the scan: leaves the sum of each left half in Sums for the
+// down-sweep. The sums of the halves are kept in the job, which continues
+// as their combine once its children have joined.
 template <class ET, class F, class G>
 class ScanUpR : public HR2Job {
 
   ET* result;
   ET* Sums; int s; int e; F f; G g;
+  ET r1, r2;                                   // Sums of the two halves
+  int stage;
    
 public:
   ScanUpR(ET* result_, ET* Sums_, int s_, int e_, F f_, G g_,
 	  bool del=true)
     : HR2Job (del),
       result (result_),
-      Sums(Sums_), s(s_), e(e_), f(f_), g(g_)
+      Sums(Sums_), s(s_), e(e_), f(f_), g(g_),
+      stage(0)
     {}
 
   lluint size (const int block_size) {
@@ -336,7 +313,7 @@ public:
           + round_up (((e-s)/_SCAN_BSIZE)*sizeof(ET), block_size);
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (e-s>_SCAN_BSIZE)
@@ -348,18 +325,17 @@ public:
   
   void function () {
     int n = e-s;
-    if (n > _SCAN_BSIZE) {
+    if (stage == 1) {
+      *Sums = r1;
+      *result = f (r1, r2);
+      join ();
+    } else if (n > _SCAN_BSIZE) {
       int nl = _nextPow(n>>1);
       int m = s + nl;
-      ET ls, rs;
-      ET* result1= new ET; ET* result2= new ET;
-      Job *child0 = new ScanUpR<ET,F,G> (result1, Sums+1,                    s,m,f,g);
-      Job *child1 = new ScanUpR<ET,F,G> (result2, Sums+(nl>>_SCAN_LOG_BSIZE),m,e,f,g);
-      binary_fork (child0, child1,
-		   new ScanUpRCont<ET,F> (result,
-					  static_cast<ScanUpR*>(child0)->result,
-					  static_cast<ScanUpR*>(child1)->result,
-					  Sums, f,s,e));
+      stage = 1;
+      binary_fork (new ScanUpR<ET,F,G> (&r1, Sums+1,                    s,m,f,g),
+		   new ScanUpR<ET,F,G> (&r2, Sums+(nl>>_SCAN_LOG_BSIZE),m,e,f,g),
+		   this);
     } else {
       ET r = g(s);
       for (int i=s+1; i < e; i++) r = f(r,g(i));
@@ -396,7 +372,7 @@ public:
       + round_up (((e-s)/_SCAN_BSIZE)*sizeof(ET), block_size);
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (e-s>_SCAN_BSIZE)
@@ -461,10 +437,10 @@ public:
       + round_up ((n/_SCAN_BSIZE)*sizeof(ET), block_size);
   }
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE==1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
-      return STRAND_SIZE_MODE;
+      return STRAND_SIZE;
     }
   }
   
@@ -472,152 +448,82 @@ public:
     if (stage==0) {
       Sums = newA(ET,1+n/_SCAN_BSIZE);
       s = newA(ET,1);
-      unary_fork (new ScanUpR<ET,F,getA<ET> >(s,Sums,0,n,f,getA<ET>(In),false),
-		  new Scan<ET,F> (this, 1));
+      stage = 1;
+      unary_fork (new ScanUpR<ET,F,getA<ET> >(s,Sums,0,n,f,getA<ET>(In)),
+		  this);
     } else if (stage == 1) {
+      stage = 2;
       unary_fork (new ScanDownR<ET,F,getA<ET> >(Out,Sums,0,n,zero,f,getA<ET>(In)),
-		  new Scan<ET,F> (this, 2));
+		  this);
     } else {
-      delete Sums;
       *result = f(zero,*s);
+      free(Sums); free(s);
       join();
     }
   }
 };
 
-class JobGenerator {
-public:
-  virtual HR2Job* operator()(int i)=0;
-};
-
+// Parallel for over the jobs body(i), i in [s,e). Jobs are made when they
+// are reached rather than up front: the range is split only while some
+// worker is out of work, otherwise its jobs run one after the other with
+// the Pfor as its own continuation. body(i) returns the job for i, or NULL
+// to skip it; range_size(s,e,block_size) is the size of the jobs of [s,e),
+// for any block size, and must grow with e. A range is split where the
+// two halves are closest in size, not at its middle index.
+template <class Body, class RangeSize>
 class Pfor : public HR2Job {
+  Body body; RangeSize range_size;
+  int lo, hi;               // Range of the task, what size() reports
+  int s;                    // Next index to run
 
-  HR2Job** A;               // An array of jobs
-  HR2Job*** A_ptr;
-  JobGenerator *gen;
-  int n;
-  lluint* sizes, *size_sums;
-  int stage;
-  int s,e;
-  lluint **size_sums_ptr;
-
-#define ST_SIZE 10
-#define ST_SIZE_SUMS 11
-#define ST_SIZE_JOIN 12
-#define ST_GEN_JOBS 13
-#define ST_GEN_JOBS_RECURSIVE 14
-#define ST_GEN_JOBS_RECURSIVE_JOIN 15
-  
 public:
-  
-  Pfor (HR2Job**A_, int n_, lluint* size_sums_ = NULL, int stage_=0,
-       bool del=true)
-    : HR2Job (del),
-      A(A_), n(n_), size_sums(size_sums_), stage(stage_),  s(0), e(n_)
-    { }
-
-  Pfor (HR2Job**A_, int n_, lluint *sizes_, lluint* size_sums_, lluint **size_sums_ptr_,
-	int stage_=ST_SIZE,
-	bool del=true)
-    : HR2Job (del),
-      A(A_), s(0), e(n_), n(n_), sizes(sizes_), size_sums(size_sums_),
-      size_sums_ptr (size_sums_ptr_),
-      stage(stage_)  
-    { }
-  
-  Pfor (class JobGenerator *gen_, int n_, HR2Job **A_=NULL, int stage_=ST_GEN_JOBS,
-	HR2Job ***A_ptr_=NULL, lluint **size_sums_ptr_=NULL,
-	bool del=true)
-    : HR2Job (del), gen(gen_), A(A_),
-      s(0), e(n_), size_sums_ptr (size_sums_ptr_), A_ptr(A_ptr_),
-      stage(stage_) 
+  Pfor (Body body_, RangeSize range_size_, int s_, int e_, bool del=true)
+    : HR2Job (del), body(body_), range_size(range_size_),
+      lo(s_), hi(e_), s(s_)
     {}
-  
-  Pfor (class JobGenerator *gen_, int s_, int e_, HR2Job **A_=NULL, int stage_=ST_GEN_JOBS,
-	bool del=true)
-    : HR2Job (del), gen(gen_), A(A_),
-      s(s_), e(e_), 
-      stage(stage_)
-    {}
-  
-  // Cant support multiple block sizes!!
-  // Size should be same across stages.
+
   lluint size (const int block_size) {
-    switch (stage) {
-    case 0:
-    case 1:
-      if (size_sums == NULL) {
-	std::cerr<<"Jobs should be sized before calling Pfor"<<std::endl;
-	exit(-1);
-      } else {
-	return size_sums[e]-size_sums[s];
-      }
-    case ST_GEN_JOBS:
-    case ST_GEN_JOBS_RECURSIVE:
-    case ST_GEN_JOBS_RECURSIVE_JOIN:
-    case ST_SIZE:
-    case ST_SIZE_SUMS:
-    case ST_SIZE_JOIN:
-      return 2*round_up ((e-s)*sizeof(lluint), block_size)
-	+ round_up (((e-s)/_SCAN_BSIZE)*sizeof(lluint), block_size)
-	+ round_up ((e-s)*sizeof(HR2Job*), block_size);
-    }
+    return range_size (lo, hi, block_size);
   }
   lluint strand_size (const int block_size) {
-    return size(block_size);
+    if (tp_options._strand_size_mode==1) {
+      return size (block_size);
+    } else {
+      return STRAND_SIZE;
+    }
   }
-  
-  void function () {
-    //std::cout<<"Pfor: "<<stage<<" "<<s<<" "<<e<<std::endl;
-    if (stage == 0) {
-      if (n==1) {
-	unary_fork (*A, new Pfor (A,n,size_sums,1));
-      } else {
-	binary_fork (new Pfor (A,     n/2,   size_sums,     0),
-		     new Pfor (A+n/2, n-n/2, size_sums+n/2, 0),
-		     new Pfor (A,n,size_sums,1));
-      }
-
-    } else if (stage == 1) {
-      join();
 
-    } else if (stage == ST_GEN_JOBS) {
-      *A_ptr = A = new HR2Job*[e-s];
-      binary_fork (new Pfor (gen, s, (s+e)/2, A, ST_GEN_JOBS_RECURSIVE),
-		   new Pfor (gen, (s+e)/2, e, A, ST_GEN_JOBS_RECURSIVE),
-		   new Pfor (A, e-s, NULL, NULL, size_sums_ptr, ST_SIZE));      
+  // m in (s,hi) that best balances the sizes of [s,m) and [m,hi)
+  int split_point () {
+    lluint total = range_size (s, hi, 1);
+    int l = s+1, r = hi-1;
+    while (l < r) {                               // First m with [s,m) at least half
+      int m = l+(r-l)/2;
+      if (2*range_size (s, m, 1) < total)
+	l = m+1;
+      else
+	r = m;
+    }
+    if (l > s+1 && range_size (s, l-1, 1) + range_size (s, l, 1) > total)
+      return l-1;                                 // Falls short of half by less
+    return l;
+  }
 
-    } else if (stage == ST_GEN_JOBS_RECURSIVE) {
-      if (e-s<_SCAN_BSIZE) {
-	for (int i=s; i<e; ++i)
-	  A[i] = (*gen)(i);
-	join ();
-      } else {
-	binary_fork (new Pfor (gen, s, (s+e)/2, A, ST_GEN_JOBS_RECURSIVE),
-		     new Pfor (gen, (s+e)/2, e, A, ST_GEN_JOBS_RECURSIVE),
-		     new Pfor (gen, s, e, A, ST_GEN_JOBS_RECURSIVE_JOIN));      
-      }
-      
-    } else if (stage == ST_GEN_JOBS_RECURSIVE_JOIN) {
-      join ();
-      
-    } else if (stage == ST_SIZE) {
-      if (cast(*A, false)!=NULL) {
-	sizes = new lluint[n+1];
-	sizes[n]=0;
-	unary_fork (new Map<HR2Job*, lluint, HR2Job::Size> (A,sizes,n, HR2Job::Size()),
-		    new Pfor (A,n,sizes,NULL,size_sums_ptr,ST_SIZE_SUMS));
-	return;
-      } else {
-	join();
-      }
-    } else if (stage == ST_SIZE_SUMS) {
-      *size_sums_ptr=size_sums = new lluint[n+1]; size_sums[n]=0;
-      unary_fork (new Scan<lluint, plus<lluint> > (new lluint,sizes,size_sums,n+1,plus<lluint>(),0),
-		  new Pfor (A,n,sizes,size_sums,size_sums_ptr,ST_SIZE_JOIN));
-    } else if (stage == ST_SIZE_JOIN) {
-      join();
+  void function () {
+    if (hi-s > 1 && workers_hungry ()) {
+      int from = s, m = split_point ();
+      s = hi;                                     // Only the join is left to us
+      binary_fork (new Pfor (body, range_size, from, m),
+		   new Pfor (body, range_size, m, hi),
+		   this);
+      return;
     }
+    HR2Job * job = NULL;
+    while (s < hi && (job = body (s++)) == NULL);
+    if (job == NULL)
+      join ();
+    else
+      unary_fork (job, this);
   }
 };
 
@@ -667,38 +573,46 @@ public:
   }
 };
 
+// Reduces g(s..e) with f. The leaves fold into a Reducer shared by the
+// whole tree, which the job given result merges once all have joined, so
+// f must be commutative as well as associative.
 template <class OT, class F, class G> 
 class Reduce : public HR2Job {
-  int s,e; F f; G g; OT* result; OT *v1,*v2;int stage;
+  typedef Reducer<OT,F> Views;
+  int s,e; F f; G g; OT* result; Views* views; int stage;
 
 public: 
-  Reduce (OT* result_, int s_, int e_, F f_, G g_, OT *v1_=NULL, OT *v2_=NULL,
-	  int stage_=0, bool del=true)
-    : HR2Job(del), result(result_),  //result must be allocated to size 4*n/SCAN_BSIZE and passed
-      s(s_), e(e_), f(f_), g(g_), v1(v1_), v2(v2_),
-      stage(stage_) {}
+  Reduce (OT* result_, int s_, int e_, F f_, G g_, Views* views_=NULL,
+	  bool del=true)
+    : HR2Job(del), result(result_),  //result is NULL below the root of the reduction
+      s(s_), e(e_), f(f_), g(g_), views(views_),
+      stage(0) {}
 
   lluint size (const int block_size) {return 0;}
   lluint strand_size (const int block_size) {return 0;}
 
   void function () {
-    assert (result!=NULL);
-    //printf("%d %d %d\n",s,e,stage);
+    assert (result!=NULL || views!=NULL);
     if (stage==0) {
       if ((e-s) <= _SCAN_BSIZE) {
-	*result = g(s);
-	for (int i=s+1; i<e; i++) *result = f(*result,g(i));
+	OT r = g(s);
+	for (int i=s+1; i<e; i++) r = f(r,g(i));
+	if (views == NULL) *result = r; else views->update (r);
 	join();
       } else {
+	if (views == NULL)
+	  views = new Views (get_thread()->get_pool()->max_parallel(), f);
 	int m = (s+e)/2;
-	//v1=result+1; v2=result+1+m/_SCAN_BSIZE;
-	v1=newA(OT,1);v2=newA(OT,1);
-	binary_fork (new Reduce<OT,F,G>(v1,s,m,f,g),
-		     new Reduce<OT,F,G>(v2,m,e,f,g),
-		     new Reduce<OT,F,G>(result,s,e,f,g,v1,v2,1));
+	stage = 1;                  // Continue as the join, no combine job
+	binary_fork (new Reduce<OT,F,G>(NULL,s,m,f,g,views),
+		     new Reduce<OT,F,G>(NULL,m,e,f,g,views),
+		     this);
       }
     } else if (stage==1) {
-      *result = f(*v1,*v2);
+      if (result != NULL) {
+	*result = views->get();
+	delete views;
+      }
       join();
     } else {
       fprintf(stderr,"Invalid stage number\n");
@@ -706,43 +620,98 @@ public:
   }
 };
 
+// Finds some i in [s,e) with f(i), not necessarily the first, and leaves
+// it in *result, which the caller sets to -1. The top job opens a scope
+// for the search, which the leaf that finds an i cancels: leaves still
+// queued are skipped and running ones stop at their next block. With
+// prune false the search runs to the end, for comparison.
+#define FIND_POLL_BSIZE (1<<10)
+template <class F>
+class Find : public HR2Job {
+  int* result; int s,e; F f; bool prune; bool top; int stage;
+  CancelScope search;                          // Used by the top job only
+
+public:
+  Find (int* result_, int s_, int e_, F f_, bool prune_=true, bool top_=true,
+	bool del=true)
+    : HR2Job(del), result(result_), s(s_), e(e_), f(f_),
+      prune(prune_), top(top_), stage(0) {}
+
+  lluint size (const int block_size) {return 0;}
+  lluint strand_size (const int block_size) {return 0;}
+
+  void function () {
+    if (stage == 1 || (prune && cancelled())) {
+      join();
+    } else if (e-s > _SCAN_BSIZE) {
+      int m = (s+e)/2;
+      stage = 1;
+      if (top && prune)
+	open_scope (&search);
+      binary_fork (new Find<F>(result,s,m,f,prune,false),
+		   new Find<F>(result,m,e,f,prune,false),
+		   this);
+    } else {
+      for (int i=s; i<e; i+=FIND_POLL_BSIZE) {
+	if (prune && cancelled())
+	  break;
+	int ie = min(e, i+FIND_POLL_BSIZE);
+	for (int j=i; j<ie; ++j)
+	  if (f(j)) {
+	    __sync_bool_compare_and_swap (result, -1, j);
+	    if (prune && !top)                 // Our scope is the top job's
+	      scope()->cancel();
+	    join();
+	    return;
+	  }
+      }
+      join();
+    }
+  }
+};
+
+// Up-sweep of the filter: flags each index in Fl and counts the flags,
+// leaving the count of each left half in Sums, laid out as in ScanUpR.
 template <class PRED> 
 class FilterUpR : public HR2Job {
   bool *Fl; int* Sums; int s, e; PRED f; 
-  int* result; int stage; int *v1;int *v2;
+  int* result; int r1, r2; int stage;
 
 public: 
   FilterUpR(int* result_, bool *Fl_, int* Sums_, int s_,int e_, PRED f_,
-	    int stage_=0, int* v1_=NULL, int* v2_=NULL, bool del=true)
+	    bool del=true)
     : HR2Job (del),
       result(result_), Fl(Fl_), Sums(Sums_), s(s_), e(e_), f(f_),
-      v1(v1_),v2(v2_),stage(stage_) {}
+      stage(0) {}
 
-  lluint size (const int block_size) {exit(-1);}
-  lluint strand_size (const int block_size) {exit(-1);}
+  lluint size (const int block_size) {
+    return round_up((e-s)*sizeof(bool), block_size)
+      + round_up(((e-s)/_SCAN_BSIZE)*sizeof(int), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1 || e-s>_SCAN_BSIZE)
+      return size(block_size);
+    else
+      return STRAND_SIZE;
+  }
   
   void function() {
     int n = e-s;
-    printf("Sums: %p, n: %d\n", Sums, n);
-    if (stage=0) {
-      if (n < _SCAN_BSIZE) {
-	int v = 0;
-	for (int i=s; i < e; i++) v += (Fl[i] = f(i));
-	*result=v;
-	join();
-      } else {
-	int nl = _nextPow(n>>1);
-	int m = s + nl;
-	v1 = newA(int,1); v2=newA(int,1);
-	printf("stage:%d n:%d Sums:%p %p v1:%p v2: %p\n",stage,n,Sums,Sums+(n>>_SCAN_LOG_BSIZE),v1,v2);
-	binary_fork(new FilterUpR<PRED>(v1,Fl,Sums+1,                    s,m,f),
-		    new FilterUpR<PRED>(v2,Fl,Sums+(n>>_SCAN_LOG_BSIZE),m,e,f),
-		    new FilterUpR<PRED>(result,Fl,Sums,s,e,f,1,v1,v2) );
-      } 
+    if (stage == 1) {
+      *Sums = r1;
+      *result = r1+r2;
+      join();
+    } else if (n > _SCAN_BSIZE) {
+      int nl = _nextPow(n>>1);
+      int m = s + nl;
+      stage = 1;
+      binary_fork(new FilterUpR<PRED>(&r1,Fl,Sums+1,                    s,m,f),
+		  new FilterUpR<PRED>(&r2,Fl,Sums+(nl>>_SCAN_LOG_BSIZE),m,e,f),
+		  this);
     } else {
-      printf("stage:%d n:%d Sums:%p %p v1:%p v2: %p\n",stage,n,Sums,Sums+(n>>_SCAN_LOG_BSIZE),v1,v2);
-      *Sums = *v1;
-      *result = *v1+*v2;
+      int v = 0;
+      for (int i=s; i < e; i++) v += (Fl[i] = f(i));
+      *result=v;
       join();
     }
   }
@@ -756,36 +725,44 @@ class FilterDownR : public HR2Job {
   
 public:
   FilterDownR (bool *Fl_, ET* Out_, int* Sums_, int s_, int e_, int v_, F f_,
-	       int stage_=0, bool del=false) 
+	       bool del=true) 
     : HR2Job(del),
       Fl(Fl_), Out(Out_), Sums(Sums_), s(s_), e(e_), v(v_), f(f_), 
-      stage(stage_) {}
+      stage(0) {}
   
-  lluint size (const int block_size) {exit(-1);}
-  lluint strand_size (const int block_size) {exit(-1);}
+  lluint size (const int block_size) {
+    return round_up((e-s)*sizeof(bool), block_size)
+      + round_up((e-s)*sizeof(ET), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1 || e-s>_SCAN_BSIZE)
+      return size(block_size);
+    else
+      return STRAND_SIZE;
+  }
   
   void function ()  {
     int n = e-s;
-    if (stage==0) {
-      if (n < _SCAN_BSIZE) {
-	int j = v;
-	for (int i=s; i<e; i++) 
-	  if (Fl[i]) Out[j++] = f(i);
-	join();
-      } else {
-	int nl = _nextPow(n>>1);
-	int m = s + nl;
-	printf("%d %p %p\n",n,Sums,Sums+(n>>_SCAN_LOG_BSIZE));
-	binary_fork(new FilterDownR<ET,F>(Fl,Out,Sums+1,             s,m,v      ,f),
-		    new FilterDownR<ET,F>(Fl,Out,Sums+(n>>_SCAN_LOG_BSIZE),m,e,v+*Sums,f),
-		    new FilterDownR<ET,F>(Fl,Out,Sums,s,e,v,f,1));
-      } 
+    if (stage == 1) {
+      join();
+    } else if (n > _SCAN_BSIZE) {
+      int nl = _nextPow(n>>1);
+      int m = s + nl;
+      stage = 1;
+      binary_fork(new FilterDownR<ET,F>(Fl,Out,Sums+1,                    s,m,v      ,f),
+		  new FilterDownR<ET,F>(Fl,Out,Sums+(nl>>_SCAN_LOG_BSIZE),m,e,v+*Sums,f),
+		  this);
     } else {
+      int j = v;
+      for (int i=s; i<e; i++) 
+	if (Fl[i]) Out[j++] = f(i);
       join();
     }
   }
 };
 
+// Writes f(i) for each i in [s,e) with p(i) to Out, packed and in order,
+// and their count to result
 template <class OT, class PRED, class F> 
 class Filter : public HR2Job {
 
@@ -794,26 +771,37 @@ class Filter : public HR2Job {
   
 public:
   Filter (int *result_, OT* Out_, int s_, int e_, PRED p_, F f_,
-	  int stage_=0, int* Sums_=NULL, bool* Fl_=NULL, bool del=false)
+	  bool del=true)
     : HR2Job(del), Out(Out_), s(s_), e(e_), p(p_), f(f_),
-      result(result_), Sums(Sums_), Fl(Fl_), stage(stage_)  {}
+      result(result_), Sums(NULL), Fl(NULL), stage(0)  {}
 
-  lluint size (const int block_size) {exit(-1);}
-  lluint strand_size (const int block_size) {exit(-1);}
+  lluint size (const int block_size) {
+    return round_up((e-s)*sizeof(bool), block_size)
+      + round_up((e-s)*sizeof(OT), block_size)
+      + round_up((1+(e-s)/_SCAN_BSIZE)*sizeof(int), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1) {
+      return size(block_size);
+    } else {
+      return STRAND_SIZE;
+    }
+  }
   
   void function() {
     int n = e-s;
     if (stage == 0) {
-      Sums = newA(int,1+4*n/_SCAN_BSIZE);
-      printf("Sums: %p, %p\n", Sums, Sums+1+4*n/_SCAN_BSIZE);
-      bool *Fl = newA(bool,n);
+      Sums = newA(int,1+n/_SCAN_BSIZE);
+      Fl = newA(bool,n) - s;                   // Indexed by i in [s,e)
+      stage = 1;
       unary_fork (new FilterUpR<PRED>(result,Fl,Sums,s,e,p),
-		  new Filter<OT,PRED,F>(result,Out,s,e,p,f,1));
+		  this);
     } else if (stage == 1) {
+      stage = 2;
       unary_fork (new FilterDownR<OT,F>(Fl,Out,Sums,s,e,0,f),
-		  new Filter<OT,PRED,F>(result,Out,s,e,p,f,2));
+		  this);
     } else {
-      delete Sums; delete Fl;
+      free(Sums); free(Fl+s);
       join();
     }
   }
@@ -0,0 +1,132 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include "ThreadPool.hh"
+#include "machine-config.hh"
+#include "parse-args.hh"
+
+// tp_sync on jobs that fork with a separate continuation, which are done
+// only once their last continuation joins. The driver runs Outer and
+// syncs on it from outside the pool; Outer runs a Sum and syncs on it
+// from a worker, then forks one of its own.
+//   Usage: sync <W/2/3/4/5/6/7> <n>
+
+#define USAGE "Usage: sync <W/2/3/4/5/6/7> <n>"
+#define SUM_BSIZE 4096
+
+// Sum of lo..hi-1, written to *ret by the last continuation
+class Sum : public HR2Job {
+  long *     ret;
+  long       lo, hi;
+  long *     parts;                           // Of the children, set in the continuation
+
+public:
+  Sum (long * ret_, long lo_, long hi_, long * parts_=NULL, bool del=true)
+    : HR2Job (del), ret(ret_), lo(lo_), hi(hi_), parts(parts_) {}
+
+  lluint size (const int block_size) {
+    return round_up ((hi-lo)*sizeof(long), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    return STRAND_SIZE;
+  }
+
+  void function () {
+    if (parts != NULL) {
+      *ret = parts[0] + parts[1];
+      delete [] parts;
+      join ();
+    } else if (hi-lo <= SUM_BSIZE) {
+      long s = 0;
+      for (long i=lo; i<hi; ++i)
+	s += i;
+      *ret = s;
+      join ();
+    } else {
+      long m = (lo+hi)/2;
+      long * p = new long[2];
+      binary_fork (new Sum (&p[0], lo, m), new Sum (&p[1], m, hi),
+		   new Sum (ret, lo, hi, p));
+    }
+  }
+};
+
+class Outer : public HR2Job {
+  long *     ret;
+  long *     inner;
+  long       n;
+
+public:
+  Outer (long * ret_, long * inner_, long n_)
+    : HR2Job (false), ret(ret_), inner(inner_), n(n_) {}
+
+  lluint size (const int block_size) {
+    return 2*round_up (n*sizeof(long), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    return STRAND_SIZE;
+  }
+
+  void function () {
+    Sum * sum = new Sum (inner, 0, n, NULL, false);
+    tp_run (sum);
+    tp_sync (sum);                              // Runs other jobs until the sum is done
+    delete sum;
+
+    long m = n/2;
+    long * p = new long[2];
+    binary_fork (new Sum (&p[0], 0, m), new Sum (&p[1], m, n),
+		 new Sum (ret, 0, n, p));
+  }
+};
+
+int
+main (int argv, char **argc) {
+  if (argv < 3) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  long n = get_size(argv, argc, 2);
+
+  Scheduler *sched=create_scheduler (argv, argc);
+  tp_init (num_procs, map, sched);
+
+  long outer = 0, inner = 0;
+  Outer * root = new Outer (&outer, &inner, n);
+  startTime();
+  tp_run (root);
+  tp_sync (root);
+  nextTime("Total time, measured from driver program");
+  delete root;
+
+  long expect = n*(n-1)/2;
+  if (inner != expect || outer != expect) {
+    std::cerr<<"Synced before the sums were done: "<<inner<<" and "<<outer
+	     <<", not "<<expect<<std::endl;
+    exit(-1);
+  }
+  tp_done ();
+}
@@ -46,7 +46,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE == 1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (stage==0 && cCount<=_PAR_TRANS_THRESHHOLD && rCount<=_PAR_TRANS_THRESHHOLD) {
@@ -194,7 +194,7 @@ public:
   }
 
   lluint strand_size (const int block_size) {
-    if (STRAND_SIZE_MODE == 1) {
+    if (tp_options._strand_size_mode==1) {
       return size(block_size);
     } else {
       if (stage==0 && cCount<=_PAR_TRANS_THRESHHOLD && rCount<=_PAR_TRANS_THRESHHOLD) {
@@ -51,7 +51,7 @@ flush_cache (int procs, int L3_size) {
   for (int p=0; p<procs; ++p) {
     set_proc_affinity(p);
     for (int i=0; i<len; ++i)
-      sum += ++flush[i];
+      sum = sum + ++flush[i];
   }
   delete flush;
   return sum;
@@ -59,8 +59,10 @@ flush_cache (int procs, int L3_size) {
 
 void
 stripe (char *space, int alloc_size, int page_size=-1) {
-  if (page_size == -1) 
-    page_size = HUGE_PAGE_SIZE;
+  if (page_size == -1) {
+    char * env = getenv ("TP_HUGE_PAGE_SIZE");      // Overrides the build default
+    page_size = env != NULL ? atoi (env) : HUGE_PAGE_SIZE;
+  }
   int num_pages = alloc_size/page_size;
   for (int i=0; i<STRIPE_SOCKETS; ++i) {
     set_proc_affinity(i);
@@ -0,0 +1,163 @@
+// This code is part of the project "Experimental Analysis of Space-Bounded
+// Schedulers", presented at Symposium on Parallelism in Algorithms and
+// Architectures, 2014.
+// Copyright (c) 2014 Harsha Vardhan Simhadri, Guy Blelloch, Phillip Gibbons,
+// Jeremy Fineman, Aapo Kyrola.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include <string.h>
+#include "ThreadPool.hh"
+#include "Future.hh"
+#include "machine-config.hh"
+#include "utils.hh"
+#include "parse-args.hh"
+
+// Wavefront over an n x n grid, cut into blocks: A[i][j] depends on its
+// upper, left and upper-left neighbours, so block (bi,bj) can start once
+// (bi-1,bj) and (bi,bj-1) are done. Dataflow runs each block as a
+// FutureJob as soon as those two have joined; with 'w' the anti-diagonals
+// of blocks run as fork-join waves instead, with a barrier after each.
+//   Usage: wavefront <W/2/3/4/5/6/7> <n> <block> [w]
+
+#define USAGE "Usage: wavefront <W/2/3/4/5/6/7> <n> <block> [w]"
+
+inline double
+cell (double up, double left, double diag) {
+  return 0.5*up + 0.3*left - 0.2*diag + 1e-3;
+}
+
+class Block : public FutureJob {
+  double *   A;
+  int        n;
+  int        bs;
+  int        bi, bj;
+
+public:
+  Block (double * A_, int n_, int bs_, int bi_, int bj_, bool del=true)
+    : FutureJob (del), A(A_), n(n_), bs(bs_), bi(bi_), bj(bj_) {}
+
+  lluint size (const int block_size) {
+    return bs*round_up (bs*sizeof(double), block_size)
+      + round_up ((bs+1)*sizeof(double), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    return size (block_size);
+  }
+
+  void function () {
+    for (int i=std::max(1,bi*bs); i<(bi+1)*bs; ++i)
+      for (int j=std::max(1,bj*bs); j<(bj+1)*bs; ++j)
+	A[i*n+j] = cell (A[(i-1)*n+j], A[i*n+j-1], A[(i-1)*n+j-1]);
+    join ();
+  }
+};
+
+class Wavefront : public HR2Job {
+  double *   A;
+  int        n;
+  int        bs;
+  bool       waves;
+  int        stage;                            // Waves: the anti-diagonal to run next
+
+public:
+  Wavefront (double * A_, int n_, int bs_, bool waves_, bool del=true)
+    : HR2Job (del), A(A_), n(n_), bs(bs_), waves(waves_), stage(0) {}
+
+  lluint size (const int block_size) {
+    return n*round_up (n*sizeof(double), block_size);
+  }
+  lluint strand_size (const int block_size) {
+    if (tp_options._strand_size_mode==1) {
+      return size (block_size);
+    } else {
+      return STRAND_SIZE;
+    }
+  }
+
+  void function () {
+    int nb = n/bs;
+    if (!waves) {
+      if (stage == 0) {
+	FutureJob ** blocks = new FutureJob*[nb*nb];
+	for (int bi=0; bi<nb; ++bi)
+	  for (int bj=0; bj<nb; ++bj) {
+	    blocks[bi*nb+bj] = new Block (A, n, bs, bi, bj);
+	    if (bi > 0) blocks[bi*nb+bj]->depends_on (blocks[(bi-1)*nb+bj]);
+	    if (bj > 0) blocks[bi*nb+bj]->depends_on (blocks[bi*nb+bj-1]);
+	  }
+	stage = 1;
+	FutureJob::fork_dag (this, nb*nb, blocks, this);
+	delete [] blocks;
+      } else {
+	join ();
+      }
+    } else if (stage < 2*nb-1) {
+      int d = stage;
+      int lo = std::max (0, d-nb+1), hi = std::min (d, nb-1);
+      Job ** blocks = new Job*[hi-lo+1];
+      for (int bi=lo; bi<=hi; ++bi)
+	blocks[bi-lo] = new Block (A, n, bs, bi, d-bi);
+      stage = d+1;
+      fork (hi-lo+1, blocks, this);
+    } else {
+      join ();
+    }
+  }
+};
+
+int
+main (int argv, char **argc) {
+  if (argv < 4) {
+    std::cerr<<USAGE<<std::endl;
+    exit(-1);
+  }
+  int n = get_size(argv, argc, 2);
+  int bs = get_size(argv, argc, 3);
+  bool waves = (argv > 4 && *argc[4] == 'w');
+  if (bs <= 0 || n % bs != 0) {
+    std::cerr<<"The block has to divide n"<<std::endl;
+    exit(-1);
+  }
+
+  double * A = newA(double, (lluint)n*n);
+  double * R = newA(double, (lluint)n*n);
+  for (int i=0; i<n; ++i) {
+    A[i] = R[i] = 1.0/(i+1);
+    A[i*n] = R[i*n] = 1.0/(i+1);
+  }
+
+  Scheduler *sched=create_scheduler (argv, argc);
+  std::cout<<"n: "<<n<<", block: "<<bs<<(waves ? ", fork-join waves" : ", dataflow")<<std::endl;
+  startTime();
+  tp_init (num_procs, map, sched, new Wavefront (A, n, bs, waves));
+  tp_sync_all ();
+  nextTime("Total time, measured from driver program");
+
+  for (int i=1; i<n; ++i)
+    for (int j=1; j<n; ++j)
+      R[i*n+j] = cell (R[(i-1)*n+j], R[i*n+j-1], R[(i-1)*n+j-1]);
+  for (lluint i=0; i<(lluint)n*n; ++i)
+    if (A[i] != R[i]) {
+      std::cerr<<"Check failed at "<<i/n<<","<<i%n<<std::endl;
+      exit(-1);
+    }
+}